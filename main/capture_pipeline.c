@@ -0,0 +1,326 @@
+#include "capture_pipeline.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <esp_bit_defs.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/event_groups.h>
+#include "sdkconfig.h"
+#include "metrics.h"
+
+static const char *TAG = "capture_pipeline";
+
+// How often blocked tasks wake up to check for a stop request
+#define STOP_POLL_MS 100
+
+#define CAPTURE_TASK_EXITED BIT0
+#define UPLOAD_TASK_EXITED  BIT1
+
+struct capture_pipeline {
+    capture_pipeline_config_t config;
+    size_t num_slots;       // queue_len + tap_slots
+    pipeline_frame_t *slots;
+    atomic_uint_least32_t *refs;  // Holders of each queued slot: the uploader plus any tap retains
+    QueueHandle_t free_q;   // Slots ready to be filled by the capture task
+    QueueHandle_t ready_q;  // Captured slots waiting for the upload task, oldest first
+    EventGroupHandle_t exit_events;
+    volatile bool stop_requested;
+    volatile uint32_t capture_interval_ms;
+    uint32_t next_seq;
+    capture_pipeline_stats_t stats;
+};
+
+void *capture_pipeline_alloc_buffer(size_t size)
+{
+#if CONFIG_SPIRAM
+    return heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+#else
+    return malloc(size);
+#endif
+}
+
+void capture_pipeline_frame_retain(capture_pipeline_handle_t pipeline, const pipeline_frame_t *frame)
+{
+    atomic_fetch_add_explicit(&pipeline->refs[frame - pipeline->slots], 1, memory_order_relaxed);
+}
+
+// The last holder puts the slot back on the free queue
+void capture_pipeline_frame_release(capture_pipeline_handle_t pipeline, const pipeline_frame_t *frame)
+{
+    if (atomic_fetch_sub_explicit(&pipeline->refs[frame - pipeline->slots], 1, memory_order_acq_rel) == 1)
+    {
+        pipeline_frame_t *slot = &pipeline->slots[frame - pipeline->slots];
+        xQueueSend(pipeline->free_q, &slot, 0);
+    }
+}
+
+// Take a slot to capture into. The upload backlog stays within queue_len
+// whatever the tap holds: when it is full the oldest queued frame is dropped,
+// so capture never waits on the network.
+static pipeline_frame_t *acquire_slot(struct capture_pipeline *p)
+{
+    pipeline_frame_t *slot = NULL;
+
+    if (uxQueueMessagesWaiting(p->ready_q) >= p->config.queue_len - 1 &&
+        xQueueReceive(p->ready_q, &slot, 0) == pdTRUE)
+    {
+        p->stats.dropped++;
+        capture_pipeline_frame_release(p, slot);  // Frees the slot unless the tap still holds the frame
+    }
+    if (xQueueReceive(p->free_q, &slot, 0) == pdTRUE)
+    {
+        return slot;
+    }
+    // Every other slot is being uploaded or held by the tap; wait for one to come back
+    if (xQueueReceive(p->free_q, &slot, pdMS_TO_TICKS(STOP_POLL_MS)) == pdTRUE)
+    {
+        return slot;
+    }
+    return NULL;
+}
+
+static void capture_task(void *pvParameters)
+{
+    struct capture_pipeline *p = pvParameters;
+    const capture_pipeline_config_t *cfg = &p->config;
+    TickType_t last_wake = xTaskGetTickCount();
+
+    while (!p->stop_requested)
+    {
+        pipeline_frame_t *slot = acquire_slot(p);
+        if (!slot)
+        {
+            continue;
+        }
+
+        slot->len = 0;
+        slot->timestamp_us = esp_timer_get_time();
+        esp_err_t err = cfg->source.capture(cfg->source.ctx, slot);
+        if (err != ESP_OK)
+        {
+            p->stats.capture_errors++;
+            ESP_LOGW(TAG, "Capture failed: %s", esp_err_to_name(err));
+            xQueueSend(p->free_q, &slot, 0);
+            vTaskDelay(pdMS_TO_TICKS(STOP_POLL_MS));
+            continue;
+        }
+
+        bool tap_only = false;
+        for (size_t i = 0; i < cfg->num_stages && err == ESP_OK; i++)
+        {
+            err = cfg->stages[i].process(cfg->stages[i].ctx, slot);
+            if (err == FRAME_STAGE_TAP_ONLY)
+            {
+                tap_only = true;
+                err = cfg->tap.publish ? ESP_OK : FRAME_STAGE_SKIP;
+            }
+        }
+
+        if (err == ESP_OK && tap_only)
+        {
+            slot->seq = p->next_seq++;
+            atomic_store_explicit(&p->refs[slot - p->slots], 1, memory_order_relaxed);  // This task's
+            cfg->tap.publish(cfg->tap.ctx, p, slot);
+            capture_pipeline_frame_release(p, slot);  // Frees the slot unless the tap kept the frame
+            p->stats.skipped++;
+        }
+        else if (err == ESP_OK)
+        {
+            slot->seq = p->next_seq++;
+            atomic_store_explicit(&p->refs[slot - p->slots], 1, memory_order_relaxed);  // The uploader's
+            if (cfg->tap.publish)
+            {
+                cfg->tap.publish(cfg->tap.ctx, p, slot);
+            }
+            xQueueSend(p->ready_q, &slot, 0);  // Never full: it is sized for every slot
+            p->stats.captured++;
+        }
+        else
+        {
+            if (err == FRAME_STAGE_SKIP)
+            {
+                p->stats.skipped++;
+            }
+            else
+            {
+                p->stats.stage_errors++;
+                ESP_LOGW(TAG, "Frame processing failed: %s", esp_err_to_name(err));
+            }
+            xQueueSend(p->free_q, &slot, 0);
+        }
+
+        uint32_t interval_ms = p->capture_interval_ms;
+        if (interval_ms > 0)
+        {
+            vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(interval_ms));
+        }
+    }
+
+    xEventGroupSetBits(p->exit_events, CAPTURE_TASK_EXITED);
+    vTaskDelete(NULL);
+}
+
+static void upload_task(void *pvParameters)
+{
+    struct capture_pipeline *p = pvParameters;
+    const capture_pipeline_config_t *cfg = &p->config;
+
+    while (!p->stop_requested)
+    {
+        pipeline_frame_t *slot = NULL;
+        if (xQueueReceive(p->ready_q, &slot, pdMS_TO_TICKS(STOP_POLL_MS)) != pdTRUE)
+        {
+            if (cfg->uploader.idle)
+            {
+                cfg->uploader.idle(cfg->uploader.ctx);
+            }
+            continue;
+        }
+
+        esp_err_t err = cfg->uploader.upload(cfg->uploader.ctx, slot);
+        if (err == ESP_OK)
+        {
+            p->stats.uploaded++;
+            metrics_since(METRIC_FRAME, slot->timestamp_us);
+        }
+        else if (err == FRAME_UPLOAD_DEFERRED)
+        {
+            p->stats.deferred++;
+        }
+        else
+        {
+            p->stats.upload_errors++;
+            metrics_record_error(METRIC_FRAME);
+            ESP_LOGW(TAG, "Upload of frame %" PRIu32 " failed: %s", slot->seq, esp_err_to_name(err));
+        }
+
+        capture_pipeline_frame_release(p, slot);
+    }
+
+    xEventGroupSetBits(p->exit_events, UPLOAD_TASK_EXITED);
+    vTaskDelete(NULL);
+}
+
+static void free_pipeline(struct capture_pipeline *p)
+{
+    if (p->slots)
+    {
+        for (size_t i = 0; i < p->num_slots; i++)
+        {
+            free(p->slots[i].buf);
+        }
+        free(p->slots);
+    }
+    free(p->refs);
+    if (p->free_q)
+    {
+        vQueueDelete(p->free_q);
+    }
+    if (p->ready_q)
+    {
+        vQueueDelete(p->ready_q);
+    }
+    if (p->exit_events)
+    {
+        vEventGroupDelete(p->exit_events);
+    }
+    free(p);
+}
+
+esp_err_t capture_pipeline_start(const capture_pipeline_config_t *config,
+                                 capture_pipeline_handle_t *out_handle)
+{
+    if (!config || !out_handle || !config->source.capture || !config->uploader.upload ||
+        config->queue_len < 2 || config->frame_capacity == 0 ||
+        config->num_stages > PIPELINE_MAX_STAGES)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct capture_pipeline *p = calloc(1, sizeof(*p));
+    if (!p)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    p->config = *config;
+    p->capture_interval_ms = config->capture_interval_ms;
+    p->num_slots = config->queue_len + config->tap_slots;
+
+    p->slots = calloc(p->num_slots, sizeof(pipeline_frame_t));
+    p->refs = calloc(p->num_slots, sizeof(atomic_uint_least32_t));
+    p->free_q = xQueueCreate(p->num_slots, sizeof(pipeline_frame_t *));
+    p->ready_q = xQueueCreate(p->num_slots, sizeof(pipeline_frame_t *));
+    p->exit_events = xEventGroupCreate();
+    if (!p->slots || !p->refs || !p->free_q || !p->ready_q || !p->exit_events)
+    {
+        free_pipeline(p);
+        return ESP_ERR_NO_MEM;
+    }
+
+    for (size_t i = 0; i < p->num_slots; i++)
+    {
+        pipeline_frame_t *slot = &p->slots[i];
+        slot->buf = capture_pipeline_alloc_buffer(config->frame_capacity);
+        if (!slot->buf)
+        {
+            ESP_LOGE(TAG, "Failed to allocate %zu byte frame slot", config->frame_capacity);
+            free_pipeline(p);
+            return ESP_ERR_NO_MEM;
+        }
+        slot->capacity = config->frame_capacity;
+        xQueueSend(p->free_q, &slot, 0);
+    }
+
+    if (xTaskCreatePinnedToCore(upload_task, "upload_task", config->task_stack_size, p,
+                                config->task_priority, NULL, config->upload_core) != pdPASS)
+    {
+        free_pipeline(p);
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreatePinnedToCore(capture_task, "capture_task", config->task_stack_size, p,
+                                config->task_priority, NULL, config->capture_core) != pdPASS)
+    {
+        p->stop_requested = true;
+        xEventGroupWaitBits(p->exit_events, UPLOAD_TASK_EXITED, pdFALSE, pdTRUE, portMAX_DELAY);
+        free_pipeline(p);
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Pipeline started: %zu slots of %zu bytes, capture on core %d, upload on core %d",
+             p->num_slots, config->frame_capacity, config->capture_core, config->upload_core);
+    *out_handle = p;
+    return ESP_OK;
+}
+
+esp_err_t capture_pipeline_stop(capture_pipeline_handle_t pipeline)
+{
+    if (!pipeline)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pipeline->stop_requested = true;
+    xEventGroupWaitBits(pipeline->exit_events, CAPTURE_TASK_EXITED | UPLOAD_TASK_EXITED,
+                        pdFALSE, pdTRUE, portMAX_DELAY);
+    free_pipeline(pipeline);
+    return ESP_OK;
+}
+
+void capture_pipeline_get_stats(capture_pipeline_handle_t pipeline,
+                                capture_pipeline_stats_t *out_stats)
+{
+    *out_stats = pipeline->stats;
+    out_stats->queued = uxQueueMessagesWaiting(pipeline->ready_q);
+}
+
+void capture_pipeline_set_capture_interval(capture_pipeline_handle_t pipeline, uint32_t interval_ms)
+{
+    pipeline->capture_interval_ms = interval_ms;
+}
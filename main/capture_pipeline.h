@@ -0,0 +1,143 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Payload encoding of a pipeline frame
+typedef enum {
+    FRAME_FORMAT_RGB565 = 0,
+    FRAME_FORMAT_JPEG,
+    FRAME_FORMAT_Q565,      // Lossless, see q565.h
+} frame_format_t;
+
+// Maximum number of processing stages between capture and upload
+#define PIPELINE_MAX_STAGES 4
+
+// Frame results live above the esp_err_t code space, so an ESP-IDF error
+// passed up from a stage or an uploader can never be mistaken for one
+#define FRAME_RESULT_BASE 0x7f000000
+
+// Returned by a processing stage to drop a frame that is not worth uploading
+#define FRAME_STAGE_SKIP (FRAME_RESULT_BASE + 1)
+
+// Returned by an uploader that kept the frame for later delivery (spooled
+// while offline, for example). Counted as deferred: neither an upload nor a
+// failure, and no latency sample.
+#define FRAME_UPLOAD_DEFERRED (FRAME_RESULT_BASE + 2)
+
+// Returned by a processing stage to keep a frame from upload but still show
+// it to the tap: the remaining stages run and the tap sees the result, so a
+// live view keeps moving while nothing changes. Counted as skipped. Without a
+// tap it is the same as FRAME_STAGE_SKIP.
+#define FRAME_STAGE_TAP_ONLY (FRAME_RESULT_BASE + 3)
+
+// One slot of the bounded frame queue. The buffer is allocated once (in PSRAM
+// when available) when the pipeline starts and is reused for every frame.
+typedef struct {
+    uint8_t *buf;           // Payload bytes
+    size_t len;             // Bytes of buf currently in use
+    size_t capacity;        // Allocated size of buf
+    uint16_t width;         // Frame width in pixels
+    uint16_t height;        // Frame height in pixels
+    frame_format_t format;  // Encoding of buf
+    uint32_t seq;           // Capture sequence number
+    int64_t timestamp_us;   // Capture time (esp_timer clock)
+} pipeline_frame_t;
+
+// Produces frames. capture() fills the caller's slot (buf/capacity are set,
+// everything else is up to the source) and must not keep a reference to it.
+typedef struct {
+    esp_err_t (*capture)(void *ctx, pipeline_frame_t *frame);
+    void *ctx;
+} frame_source_t;
+
+// Consumes frames. upload() owns the slot only for the duration of the call.
+// idle(), if set, is called on the upload task whenever the queue stays empty
+// for a while, for background work such as replaying spooled frames.
+typedef struct {
+    esp_err_t (*upload)(void *ctx, const pipeline_frame_t *frame);
+    void (*idle)(void *ctx);
+    void *ctx;
+} frame_uploader_t;
+
+// Processes a captured frame on the capture task before it is queued. A stage
+// may rewrite the frame in place, or swap frame->buf for a buffer of the same
+// capacity that it owns (see capture_pipeline_alloc_buffer) and keep the old one.
+// Returning FRAME_STAGE_SKIP discards the frame without counting it as an error;
+// FRAME_STAGE_TAP_ONLY does the same once the tap has seen it.
+typedef struct {
+    esp_err_t (*process)(void *ctx, pipeline_frame_t *frame);
+    void *ctx;
+} frame_stage_t;
+
+typedef struct capture_pipeline *capture_pipeline_handle_t;
+
+// Sees every frame queued for upload, and every frame a stage marked
+// FRAME_STAGE_TAP_ONLY, on the capture task once all stages have run.
+// publish() must not block. It may keep the frame after returning by
+// calling capture_pipeline_frame_retain(); from then on the frame is shared
+// read-only with the uploader, and its slot is reused only after the last
+// holder has released it.
+typedef struct {
+    void (*publish)(void *ctx, capture_pipeline_handle_t pipeline, const pipeline_frame_t *frame);
+    void *ctx;
+} frame_tap_t;
+
+typedef struct {
+    frame_source_t source;
+    frame_stage_t stages[PIPELINE_MAX_STAGES];  // Run in order after each capture
+    size_t num_stages;
+    frame_uploader_t uploader;
+    frame_tap_t tap;               // Optional
+    size_t queue_len;              // Number of frame slots, at least 2
+    size_t tap_slots;              // Extra slots for frames the tap holds, so capture never waits on it
+    size_t frame_capacity;         // Size of each slot buffer in bytes
+    uint32_t capture_interval_ms;  // Minimum period between captures, 0 = free-running
+    int capture_core;              // Core for the capture task
+    int upload_core;               // Core for the upload task
+    uint32_t task_stack_size;
+    unsigned task_priority;
+} capture_pipeline_config_t;
+
+// Counters are only ever written by one task each and may be read at any time
+typedef struct {
+    uint32_t captured;        // Frames queued for upload
+    uint32_t dropped;         // Queued frames overwritten because the uploader fell behind
+    uint32_t capture_errors;  // Failed source captures
+    uint32_t skipped;         // Frames a processing stage chose not to upload
+    uint32_t stage_errors;    // Frames discarded because a processing stage failed
+    uint32_t uploaded;        // Successful uploads
+    uint32_t upload_errors;   // Failed uploads
+    uint32_t deferred;        // Frames the uploader kept for later delivery
+    uint32_t queued;          // Frames waiting for upload right now
+} capture_pipeline_stats_t;
+
+// Allocate a frame buffer the same way the pipeline allocates its slots
+void *capture_pipeline_alloc_buffer(size_t size);
+
+// Allocate the frame slots and start the capture and upload tasks
+esp_err_t capture_pipeline_start(const capture_pipeline_config_t *config,
+                                 capture_pipeline_handle_t *out_handle);
+
+// Stop both tasks, wait for them to exit and free all slots
+esp_err_t capture_pipeline_stop(capture_pipeline_handle_t pipeline);
+
+void capture_pipeline_get_stats(capture_pipeline_handle_t pipeline,
+                                capture_pipeline_stats_t *out_stats);
+
+// Change the minimum period between captures, effective from the next capture
+void capture_pipeline_set_capture_interval(capture_pipeline_handle_t pipeline, uint32_t interval_ms);
+
+// Take and drop a reference to a published frame. Safe from any task.
+void capture_pipeline_frame_retain(capture_pipeline_handle_t pipeline, const pipeline_frame_t *frame);
+
+void capture_pipeline_frame_release(capture_pipeline_handle_t pipeline, const pipeline_frame_t *frame);
+
+#ifdef __cplusplus
+}
+#endif
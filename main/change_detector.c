@@ -0,0 +1,202 @@
+#include "change_detector.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define TILE CHANGE_DETECTOR_TILE_SIZE
+
+struct change_detector {
+    change_detector_config_t config;
+    size_t max_stride;       // Thumbnail buffers are sized for the largest frame
+    size_t max_rows;
+    uint8_t *current;        // Thumbnail of the frame being analysed
+    uint8_t *reference;      // Thumbnail of the last forwarded frame
+    uint16_t *row_acc;       // Per-column sums while downsampling one thumbnail row
+    uint16_t ref_width;      // Source size the reference was taken at, 0 = no reference
+    uint16_t ref_height;
+    uint32_t skipped;        // Consecutive skipped frames
+};
+
+static inline size_t round_up_tile(size_t n)
+{
+    return (n + TILE - 1) / TILE * TILE;
+}
+
+esp_err_t change_detector_create(const change_detector_config_t *config, uint16_t max_width,
+                                 uint16_t max_height, change_detector_handle_t *out_detector)
+{
+    if (!config || !out_detector || max_width == 0 || max_height == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint8_t s = config->thumb_scale;
+    if (s != 1 && s != 2 && s != 4 && s != 8)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct change_detector *det = calloc(1, sizeof(*det));
+    if (!det)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    det->config = *config;
+    det->max_stride = round_up_tile(max_width / s);
+    det->max_rows = round_up_tile(max_height / s);
+    det->current = malloc(det->max_stride * det->max_rows);
+    det->reference = malloc(det->max_stride * det->max_rows);
+    det->row_acc = malloc(det->max_stride * sizeof(uint16_t));
+    if (!det->current || !det->reference || !det->row_acc)
+    {
+        change_detector_delete(det);
+        return ESP_ERR_NO_MEM;
+    }
+
+    *out_detector = det;
+    return ESP_OK;
+}
+
+void change_detector_delete(change_detector_handle_t detector)
+{
+    if (!detector)
+    {
+        return;
+    }
+    free(detector->current);
+    free(detector->reference);
+    free(detector->row_acc);
+    free(detector);
+}
+
+void change_detector_reset(change_detector_handle_t detector)
+{
+    detector->ref_width = 0;
+    detector->ref_height = 0;
+    detector->skipped = 0;
+}
+
+// Box-filter the frame down to a luma thumbnail. Padding up to whole tiles is
+// zeroed, so it never contributes to the SAD.
+static void build_thumbnail(struct change_detector *det, const uint8_t *rgb565, uint16_t width,
+                            uint16_t height, size_t stride, size_t rows)
+{
+    const int s = det->config.thumb_scale;
+    const int shift = __builtin_ctz(s) * 2;
+    const size_t tw = width / s;
+    const size_t th = height / s;
+
+    memset(det->current, 0, stride * rows);
+
+    for (size_t ty = 0; ty < th; ty++)
+    {
+        memset(det->row_acc, 0, tw * sizeof(uint16_t));
+
+        for (int k = 0; k < s; k++)
+        {
+            const uint8_t *src = rgb565 + (ty * s + k) * width * 2;
+            for (size_t tx = 0; tx < tw; tx++)
+            {
+                uint32_t sum = 0;
+                for (int j = 0; j < s; j++)
+                {
+                    uint32_t px = ((uint32_t)src[0] << 8) | src[1];
+                    // Luma from the raw 5/6/5 fields, weights ~0.30/0.59/0.11 on a 0..255 scale
+                    sum += ((px >> 11) * 20 + ((px >> 5) & 0x3f) * 19 + (px & 0x1f) * 7) >> 3;
+                    src += 2;
+                }
+                det->row_acc[tx] += sum;
+            }
+        }
+
+        uint8_t *dst = det->current + ty * stride;
+        for (size_t tx = 0; tx < tw; tx++)
+        {
+            dst[tx] = det->row_acc[tx] >> shift;
+        }
+    }
+}
+
+// SAD of one 16x16 tile. Fixed 16-byte rows keep the inner loop branch-free
+// so the compiler can turn it into a single vector SAD per row.
+static uint32_t tile_sad(const uint8_t *a, const uint8_t *b, size_t stride)
+{
+    uint32_t sad = 0;
+
+    for (int y = 0; y < TILE; y++)
+    {
+        uint32_t row = 0;
+        for (int x = 0; x < TILE; x++)
+        {
+            int d = a[x] - b[x];
+            row += d < 0 ? -d : d;
+        }
+        sad += row;
+        a += stride;
+        b += stride;
+    }
+    return sad;
+}
+
+esp_err_t change_detector_process(change_detector_handle_t detector, const uint8_t *rgb565,
+                                  uint16_t width, uint16_t height, change_result_t *out_result)
+{
+    struct change_detector *det = detector;
+
+    if (!det || !rgb565 || !out_result)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const int s = det->config.thumb_scale;
+    const size_t stride = round_up_tile(width / s);
+    const size_t rows = round_up_tile(height / s);
+    if (width < s || height < s || stride > det->max_stride || rows > det->max_rows)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    build_thumbnail(det, rgb565, width, height, stride, rows);
+
+    const uint32_t tile_threshold = (uint32_t)det->config.pixel_threshold * TILE * TILE;
+    const size_t tiles_x = stride / TILE;
+    const size_t tiles_y = rows / TILE;
+    uint16_t changed = 0;
+    bool have_reference = det->ref_width == width && det->ref_height == height;
+
+    if (have_reference)
+    {
+        for (size_t y = 0; y < tiles_y; y++)
+        {
+            for (size_t x = 0; x < tiles_x; x++)
+            {
+                size_t offset = y * TILE * stride + x * TILE;
+                if (tile_sad(det->current + offset, det->reference + offset, stride) > tile_threshold)
+                {
+                    changed++;
+                }
+            }
+        }
+    }
+
+    bool forward = !have_reference || changed >= det->config.min_changed_tiles ||
+                   (det->config.max_skipped_frames > 0 && det->skipped >= det->config.max_skipped_frames);
+
+    if (forward)
+    {
+        // The analysed thumbnail becomes the reference without copying it
+        uint8_t *tmp = det->reference;
+        det->reference = det->current;
+        det->current = tmp;
+        det->ref_width = width;
+        det->ref_height = height;
+        det->skipped = 0;
+    }
+    else
+    {
+        det->skipped++;
+    }
+
+    out_result->changed_tiles = changed;
+    out_result->total_tiles = tiles_x * tiles_y;
+    out_result->forward = forward;
+    return ESP_OK;
+}
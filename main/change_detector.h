@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Decides whether an RGB565 frame differs enough from the last forwarded one
+// to be worth uploading. Each frame is reduced to a luma thumbnail, which is
+// compared against the reference thumbnail in 16x16 tiles by sum of absolute
+// differences (SAD). Rows are 16 bytes wide so the kernel maps onto 128-bit SIMD.
+
+#define CHANGE_DETECTOR_TILE_SIZE 16
+
+typedef struct {
+    uint8_t thumb_scale;          // Source pixels per thumbnail pixel along each axis: 1, 2, 4 or 8
+    uint8_t pixel_threshold;      // Mean absolute luma difference that marks a tile as changed
+    uint16_t min_changed_tiles;   // Frames with fewer changed tiles are skipped
+    uint32_t max_skipped_frames;  // Forward a frame after this many consecutive skips, 0 = never
+} change_detector_config_t;
+
+typedef struct {
+    uint16_t changed_tiles;
+    uint16_t total_tiles;
+    bool forward;                 // True if the frame should be uploaded
+} change_result_t;
+
+typedef struct change_detector *change_detector_handle_t;
+
+esp_err_t change_detector_create(const change_detector_config_t *config, uint16_t max_width,
+                                 uint16_t max_height, change_detector_handle_t *out_detector);
+
+// Analyse a big-endian RGB565 frame. Forwarded frames become the new reference;
+// the first frame, and the first after a resolution change, is always forwarded.
+esp_err_t change_detector_process(change_detector_handle_t detector, const uint8_t *rgb565,
+                                  uint16_t width, uint16_t height, change_result_t *out_result);
+
+// Forget the reference so the next frame is forwarded unconditionally
+void change_detector_reset(change_detector_handle_t detector);
+
+void change_detector_delete(change_detector_handle_t detector);
+
+#ifdef __cplusplus
+}
+#endif
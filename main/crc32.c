@@ -0,0 +1,33 @@
+#include "crc32.h"
+
+#ifdef ESP_PLATFORM
+#include <esp_rom_crc.h>
+
+uint32_t crc32_update(uint32_t crc, const void *data, size_t len)
+{
+    return esp_rom_crc32_le(crc, data, len);
+}
+
+#else
+
+// Host builds have no ROM helper; use a nibble-wise table to keep it small
+static const uint32_t crc_table[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+};
+
+uint32_t crc32_update(uint32_t crc, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+
+    crc = ~crc;
+    while (len--)
+    {
+        crc ^= *p++;
+        crc = (crc >> 4) ^ crc_table[crc & 0x0f];
+        crc = (crc >> 4) ^ crc_table[crc & 0x0f];
+    }
+    return ~crc;
+}
+
+#endif
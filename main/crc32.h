@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Standard CRC-32 (IEEE 802.3, same as zlib's crc32). Start with crc = 0 and
+// pass the previous result to continue over more data.
+uint32_t crc32_update(uint32_t crc, const void *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,127 @@
+#include "frame_fanout.h"
+
+#include <stdlib.h>
+#include <esp_bit_defs.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/event_groups.h>
+
+// Set while the latest frame has an even or odd sequence number. A reader that
+// has seen frame n waits for the bit of n + 1, which is already set if that
+// frame arrived between the reader's check and its wait.
+#define EVEN_FRAME BIT0
+#define ODD_FRAME  BIT1
+
+struct frame_fanout {
+    SemaphoreHandle_t lock;              // Guards everything below
+    EventGroupHandle_t events;
+    capture_pipeline_handle_t pipeline;  // Known from the first publish on
+    const pipeline_frame_t *latest;      // Retained; NULL until the first frame
+    frame_fanout_stats_t stats;
+};
+
+static inline EventBits_t parity_bit(uint32_t seq)
+{
+    return seq & 1 ? ODD_FRAME : EVEN_FRAME;
+}
+
+esp_err_t frame_fanout_create(frame_fanout_handle_t *out_fanout)
+{
+    struct frame_fanout *f = calloc(1, sizeof(*f));
+    if (!f)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    f->lock = xSemaphoreCreateMutex();
+    f->events = xEventGroupCreate();
+    if (!f->lock || !f->events)
+    {
+        if (f->lock)
+        {
+            vSemaphoreDelete(f->lock);
+        }
+        if (f->events)
+        {
+            vEventGroupDelete(f->events);
+        }
+        free(f);
+        return ESP_ERR_NO_MEM;
+    }
+    *out_fanout = f;
+    return ESP_OK;
+}
+
+void frame_fanout_publish(void *ctx, capture_pipeline_handle_t pipeline, const pipeline_frame_t *frame)
+{
+    struct frame_fanout *f = ctx;
+
+    capture_pipeline_frame_retain(pipeline, frame);
+    xSemaphoreTake(f->lock, portMAX_DELAY);
+    const pipeline_frame_t *old = f->latest;
+    f->latest = frame;
+    f->pipeline = pipeline;
+    f->stats.published++;
+    xSemaphoreGive(f->lock);
+
+    if (old)
+    {
+        capture_pipeline_frame_release(pipeline, old);
+    }
+    xEventGroupClearBits(f->events, parity_bit(frame->seq + 1));
+    xEventGroupSetBits(f->events, parity_bit(frame->seq));
+}
+
+const pipeline_frame_t *frame_fanout_acquire(frame_fanout_handle_t fanout, frame_fanout_reader_t *reader,
+                                             uint32_t timeout_ms)
+{
+    struct frame_fanout *f = fanout;
+    bool waited = false;
+
+    while (true)
+    {
+        xSemaphoreTake(f->lock, portMAX_DELAY);
+        const pipeline_frame_t *frame = f->latest;
+        if (frame && (!reader->started || (int32_t)(frame->seq - reader->next_seq) >= 0))
+        {
+            capture_pipeline_frame_retain(f->pipeline, frame);
+            if (reader->started)
+            {
+                uint32_t skipped = frame->seq - reader->next_seq;
+                reader->skipped += skipped;
+                f->stats.skipped += skipped;
+            }
+            reader->started = true;
+            reader->next_seq = frame->seq + 1;
+            reader->frames++;
+            f->stats.delivered++;
+            f->stats.held++;
+            xSemaphoreGive(f->lock);
+            return frame;
+        }
+        xSemaphoreGive(f->lock);
+
+        if (waited)
+        {
+            return NULL;
+        }
+        EventBits_t wanted = reader->started ? parity_bit(reader->next_seq) : EVEN_FRAME | ODD_FRAME;
+        xEventGroupWaitBits(f->events, wanted, pdFALSE, pdFALSE, pdMS_TO_TICKS(timeout_ms));
+        waited = true;
+    }
+}
+
+void frame_fanout_release(frame_fanout_handle_t fanout, const pipeline_frame_t *frame)
+{
+    xSemaphoreTake(fanout->lock, portMAX_DELAY);
+    capture_pipeline_handle_t pipeline = fanout->pipeline;
+    fanout->stats.held--;
+    xSemaphoreGive(fanout->lock);
+    capture_pipeline_frame_release(pipeline, frame);
+}
+
+void frame_fanout_get_stats(frame_fanout_handle_t fanout, frame_fanout_stats_t *out_stats)
+{
+    xSemaphoreTake(fanout->lock, portMAX_DELAY);
+    *out_stats = fanout->stats;
+    xSemaphoreGive(fanout->lock);
+}
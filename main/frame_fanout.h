@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include "capture_pipeline.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Shares the latest pipeline frame with any number of readers without copying
+// it. frame_fanout_publish() is a pipeline tap: it retains each new frame and
+// releases the one it replaces. A reader takes a reference to the newest frame
+// it has not seen yet and releases it when done, so a reader that falls behind
+// skips frames instead of holding up capture or the other readers.
+//
+// The fan-out holds one frame and each reader at most one more, so a pipeline
+// with tap_slots = 1 + number of readers never runs short of slots.
+
+typedef struct {
+    uint32_t next_seq;      // First sequence number this reader has not seen
+    bool started;
+    uint32_t frames;        // Frames handed to this reader
+    uint32_t skipped;       // Frames replaced before this reader got to them
+} frame_fanout_reader_t;
+
+typedef struct {
+    uint32_t published;
+    uint32_t delivered;     // Frames handed to readers, summed over readers
+    uint32_t skipped;       // Frames readers missed, summed over readers
+    uint32_t held;          // References readers hold right now
+} frame_fanout_stats_t;
+
+typedef struct frame_fanout *frame_fanout_handle_t;
+
+esp_err_t frame_fanout_create(frame_fanout_handle_t *out_fanout);
+
+// Pipeline tap callback; ctx is the fan-out handle
+void frame_fanout_publish(void *ctx, capture_pipeline_handle_t pipeline, const pipeline_frame_t *frame);
+
+// Wait up to timeout_ms for a frame the reader has not seen and take a
+// reference to it. Returns NULL on timeout. A reader holds at most one frame.
+const pipeline_frame_t *frame_fanout_acquire(frame_fanout_handle_t fanout, frame_fanout_reader_t *reader,
+                                             uint32_t timeout_ms);
+
+void frame_fanout_release(frame_fanout_handle_t fanout, const pipeline_frame_t *frame);
+
+void frame_fanout_get_stats(frame_fanout_handle_t fanout, frame_fanout_stats_t *out_stats);
+
+#ifdef __cplusplus
+}
+#endif
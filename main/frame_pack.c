@@ -0,0 +1,373 @@
+#include "frame_pack.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <esp_log.h>
+#include "crc32.h"
+
+static const char *TAG = "frame_pack";
+
+#define HEADER_MAGIC  0x4b415046  // "FPAK"
+#define RECORD_MAGIC  0x30524d46  // "FMR0"
+#define TRAILER_MAGIC 0x584b5046  // "FPKX"
+#define PACK_VERSION  1
+#define SCAN_BUF_SIZE 1024
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    int64_t created_us;
+    uint8_t reserved[12];
+    uint32_t header_crc;     // CRC of the preceding fields
+} file_header_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t length;
+    int64_t timestamp_us;
+    uint32_t crc32;          // CRC of the payload
+    uint16_t width;
+    uint16_t height;
+    uint8_t format;
+    uint8_t reserved[3];
+    uint32_t header_crc;     // CRC of the preceding fields
+} record_header_t;
+
+typedef struct {
+    uint64_t offset;         // File offset of the payload
+    uint32_t length;
+    uint32_t crc32;          // CRC of the payload
+    int64_t timestamp_us;
+    uint16_t width;
+    uint16_t height;
+    uint8_t format;
+    uint8_t reserved[3];
+} index_entry_t;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t entry_size;
+    uint32_t frames;
+    uint32_t index_crc;      // CRC of the whole index
+    uint64_t index_offset;
+    uint32_t reserved;
+    uint32_t trailer_crc;    // CRC of the preceding fields
+} trailer_t;
+
+_Static_assert(sizeof(file_header_t) == FRAME_PACK_HEADER_SIZE, "file header layout");
+_Static_assert(sizeof(record_header_t) == FRAME_PACK_RECORD_HDR_SIZE, "record header layout");
+_Static_assert(sizeof(index_entry_t) == FRAME_PACK_INDEX_ENTRY_SIZE, "index entry layout");
+_Static_assert(sizeof(trailer_t) == FRAME_PACK_TRAILER_SIZE, "trailer layout");
+
+struct frame_pack_writer {
+    char *path;
+    FILE *file;
+    uint32_t max_frames;
+    uint32_t frames;
+    size_t size;                 // Header and records written so far
+    bool failed;                 // A write failed; the file may end in a torn record
+    index_entry_t *index;        // Built in RAM and written on finish
+};
+
+static bool file_header_valid(const file_header_t *hdr)
+{
+    return hdr->magic == HEADER_MAGIC && hdr->version == PACK_VERSION &&
+           hdr->header_crc == crc32_update(0, hdr, offsetof(file_header_t, header_crc));
+}
+
+static bool record_header_valid(const record_header_t *hdr)
+{
+    return hdr->magic == RECORD_MAGIC &&
+           hdr->header_crc == crc32_update(0, hdr, offsetof(record_header_t, header_crc));
+}
+
+static bool trailer_valid(const trailer_t *trailer)
+{
+    return trailer->magic == TRAILER_MAGIC && trailer->version == PACK_VERSION &&
+           trailer->entry_size == sizeof(index_entry_t) &&
+           trailer->trailer_crc == crc32_update(0, trailer, offsetof(trailer_t, trailer_crc));
+}
+
+static void index_frame(struct frame_pack_writer *w, const record_header_t *rec, size_t payload_offset)
+{
+    index_entry_t *e = &w->index[w->frames++];
+
+    memset(e, 0, sizeof(*e));
+    e->offset = payload_offset;
+    e->length = rec->length;
+    e->crc32 = rec->crc32;
+    e->timestamp_us = rec->timestamp_us;
+    e->width = rec->width;
+    e->height = rec->height;
+    e->format = rec->format;
+}
+
+// Pick up an unfinished pack: index its intact records and cut off anything
+// after them, including the index and trailer if the pack had been finished
+static esp_err_t resume_pack(struct frame_pack_writer *w)
+{
+    FILE *f = fopen(w->path, "rb");
+    if (!f)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    file_header_t hdr;
+    size_t end = 0;
+    if (fread(&hdr, 1, sizeof(hdr), f) == sizeof(hdr) && file_header_valid(&hdr))
+    {
+        uint8_t *buf = malloc(SCAN_BUF_SIZE);
+        record_header_t rec;
+
+        end = sizeof(hdr);
+        while (buf && w->frames < w->max_frames &&
+               fread(&rec, 1, sizeof(rec), f) == sizeof(rec) && record_header_valid(&rec))
+        {
+            uint32_t crc = 0;
+            size_t remaining = rec.length;
+            while (remaining > 0)
+            {
+                size_t n = remaining < SCAN_BUF_SIZE ? remaining : SCAN_BUF_SIZE;
+                if (fread(buf, 1, n, f) != n)
+                {
+                    break;
+                }
+                crc = crc32_update(crc, buf, n);
+                remaining -= n;
+            }
+            if (remaining > 0 || crc != rec.crc32)
+            {
+                break;
+            }
+            index_frame(w, &rec, end + sizeof(rec));
+            end += sizeof(rec) + rec.length;
+        }
+        free(buf);
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+
+    if (end == 0)
+    {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if ((size_t)size > end && truncate(w->path, end) != 0)
+    {
+        ESP_LOGE(TAG, "Truncate of %s failed: %s", w->path, strerror(errno));
+        w->frames = 0;
+        return ESP_FAIL;
+    }
+    w->size = end;
+    if (w->frames > 0)
+    {
+        ESP_LOGI(TAG, "Resumed %s with %" PRIu32 " frames", w->path, w->frames);
+    }
+    return ESP_OK;
+}
+
+esp_err_t frame_pack_writer_open(const char *path, uint32_t max_frames, int64_t created_us,
+                                 frame_pack_writer_handle_t *out_writer)
+{
+    if (!path || max_frames == 0 || !out_writer)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct frame_pack_writer *w = calloc(1, sizeof(*w));
+    if (!w)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    w->path = strdup(path);
+    w->max_frames = max_frames;
+    w->index = malloc(max_frames * sizeof(index_entry_t));
+    if (!w->path || !w->index)
+    {
+        frame_pack_writer_abort(w);
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (resume_pack(w) == ESP_OK)
+    {
+        w->file = fopen(path, "ab");
+    }
+    else
+    {
+        file_header_t hdr = {
+            .magic = HEADER_MAGIC,
+            .version = PACK_VERSION,
+            .header_size = sizeof(file_header_t),
+            .created_us = created_us,
+        };
+        hdr.header_crc = crc32_update(0, &hdr, offsetof(file_header_t, header_crc));
+
+        w->file = fopen(path, "wb");
+        if (w->file && fwrite(&hdr, 1, sizeof(hdr), w->file) != sizeof(hdr))
+        {
+            fclose(w->file);
+            w->file = NULL;
+        }
+        w->size = sizeof(hdr);
+    }
+    if (!w->file)
+    {
+        ESP_LOGE(TAG, "Failed to open %s: %s", path, strerror(errno));
+        frame_pack_writer_abort(w);
+        return ESP_FAIL;
+    }
+
+    *out_writer = w;
+    return ESP_OK;
+}
+
+esp_err_t frame_pack_writer_append(frame_pack_writer_handle_t writer, const frame_pack_entry_t *entry,
+                                   const uint8_t *data)
+{
+    struct frame_pack_writer *w = writer;
+
+    if (w->failed)
+    {
+        return ESP_FAIL;
+    }
+    if (w->frames >= w->max_frames)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    record_header_t rec = {
+        .magic = RECORD_MAGIC,
+        .length = entry->length,
+        .timestamp_us = entry->timestamp_us,
+        .crc32 = crc32_update(0, data, entry->length),
+        .width = entry->width,
+        .height = entry->height,
+        .format = entry->format,
+    };
+    rec.header_crc = crc32_update(0, &rec, offsetof(record_header_t, header_crc));
+
+    if (fwrite(&rec, 1, sizeof(rec), w->file) != sizeof(rec) ||
+        fwrite(data, 1, entry->length, w->file) != entry->length)
+    {
+        ESP_LOGE(TAG, "Write to %s failed: %s", w->path, strerror(errno));
+        w->failed = true;
+        return ESP_FAIL;
+    }
+
+    index_frame(w, &rec, w->size + sizeof(rec));
+    w->size += sizeof(rec) + entry->length;
+    return ESP_OK;
+}
+
+void frame_pack_writer_get_info(frame_pack_writer_handle_t writer, frame_pack_info_t *out_info)
+{
+    out_info->size = writer->size + writer->frames * sizeof(index_entry_t) + sizeof(trailer_t);
+    out_info->frames = writer->frames;
+    out_info->first_timestamp_us = writer->frames > 0 ? writer->index[0].timestamp_us : 0;
+}
+
+esp_err_t frame_pack_writer_finish(frame_pack_writer_handle_t writer, frame_pack_info_t *out_info)
+{
+    struct frame_pack_writer *w = writer;
+    const size_t index_size = w->frames * sizeof(index_entry_t);
+    esp_err_t err = ESP_OK;
+
+    trailer_t trailer = {
+        .magic = TRAILER_MAGIC,
+        .version = PACK_VERSION,
+        .entry_size = sizeof(index_entry_t),
+        .frames = w->frames,
+        .index_crc = crc32_update(0, w->index, index_size),
+        .index_offset = w->size,
+    };
+    trailer.trailer_crc = crc32_update(0, &trailer, offsetof(trailer_t, trailer_crc));
+
+    if (w->failed ||
+        fwrite(w->index, 1, index_size, w->file) != index_size ||
+        fwrite(&trailer, 1, sizeof(trailer), w->file) != sizeof(trailer) ||
+        fflush(w->file) != 0 || fsync(fileno(w->file)) != 0)
+    {
+        ESP_LOGE(TAG, "Failed to finish %s", w->path);
+        err = ESP_FAIL;
+    }
+    if (out_info)
+    {
+        frame_pack_writer_get_info(w, out_info);
+    }
+
+    fclose(w->file);
+    free(w->index);
+    free(w->path);
+    free(w);
+    return err;
+}
+
+void frame_pack_writer_abort(frame_pack_writer_handle_t writer)
+{
+    if (!writer)
+    {
+        return;
+    }
+    if (writer->file)
+    {
+        fclose(writer->file);
+        remove(writer->path);
+    }
+    free(writer->index);
+    free(writer->path);
+    free(writer);
+}
+
+esp_err_t frame_pack_read_info(const char *path, frame_pack_info_t *out_info)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    esp_err_t err = ESP_ERR_INVALID_RESPONSE;
+    file_header_t hdr;
+    trailer_t trailer;
+    index_entry_t first;
+    long size = -1;
+
+    if (fseek(f, 0, SEEK_END) == 0)
+    {
+        size = ftell(f);
+    }
+    if (size >= (long)(sizeof(hdr) + sizeof(trailer)) &&
+        fseek(f, size - sizeof(trailer), SEEK_SET) == 0 &&
+        fread(&trailer, 1, sizeof(trailer), f) == sizeof(trailer) && trailer_valid(&trailer) &&
+        trailer.index_offset + (uint64_t)trailer.frames * sizeof(index_entry_t) + sizeof(trailer) == (uint64_t)size &&
+        fseek(f, 0, SEEK_SET) == 0 &&
+        fread(&hdr, 1, sizeof(hdr), f) == sizeof(hdr) && file_header_valid(&hdr))
+    {
+        out_info->size = size;
+        out_info->frames = trailer.frames;
+        out_info->first_timestamp_us = 0;
+        err = ESP_OK;
+        if (trailer.frames > 0)
+        {
+            if (fseek(f, trailer.index_offset, SEEK_SET) == 0 &&
+                fread(&first, 1, sizeof(first), f) == sizeof(first))
+            {
+                out_info->first_timestamp_us = first.timestamp_us;
+            }
+            else
+            {
+                err = ESP_ERR_INVALID_RESPONSE;
+            }
+        }
+    }
+
+    fclose(f);
+    return err;
+}
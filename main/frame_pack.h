@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Writer for frame packs: several frames stored in one object so they can be
+// uploaded with a single request. A pack is written to a file incrementally,
+// one frame at a time, and never held in memory as a whole.
+//
+// Layout, all integers little-endian:
+//
+//   file header   32 bytes  magic "FPAK", version, creation time, header CRC
+//   frame record  32-byte record header (length, timestamp, geometry,
+//                 format, payload CRC-32, header CRC) + payload, repeated
+//   index         32 bytes per frame: payload offset, length, timestamp,
+//                 geometry, format, payload CRC-32
+//   trailer       32 bytes  magic "FPKX", frame count, index offset, index CRC,
+//                 trailer CRC
+//
+// The trailer is the last 32 bytes, so a reader can fetch any frame with
+// three ranged GETs: the trailer, the index, then the frame payload.
+// tools/frame_pack.py reads and validates packs on a host.
+
+#define FRAME_PACK_HEADER_SIZE      32
+#define FRAME_PACK_RECORD_HDR_SIZE  32
+#define FRAME_PACK_INDEX_ENTRY_SIZE 32
+#define FRAME_PACK_TRAILER_SIZE     32
+
+typedef struct {
+    int64_t timestamp_us;   // Capture time, microseconds since the epoch
+    uint32_t length;        // Payload size in bytes
+    uint16_t width;
+    uint16_t height;
+    uint8_t format;         // frame_format_t of the payload
+} frame_pack_entry_t;
+
+typedef struct {
+    size_t size;                    // Bytes in the file
+    uint32_t frames;
+    int64_t first_timestamp_us;     // Timestamp of the first frame, 0 if there is none
+} frame_pack_info_t;
+
+typedef struct frame_pack_writer *frame_pack_writer_handle_t;
+
+// Start a pack at path that holds up to max_frames frames. If path already
+// holds an unfinished pack, for example after a reset, its intact frames are
+// kept and new frames are appended after them.
+esp_err_t frame_pack_writer_open(const char *path, uint32_t max_frames, int64_t created_us,
+                                 frame_pack_writer_handle_t *out_writer);
+
+// Append a frame. Returns ESP_ERR_INVALID_STATE once max_frames are in the pack.
+esp_err_t frame_pack_writer_append(frame_pack_writer_handle_t writer, const frame_pack_entry_t *entry,
+                                   const uint8_t *data);
+
+// Frames in the pack and the size it would have if finished now
+void frame_pack_writer_get_info(frame_pack_writer_handle_t writer, frame_pack_info_t *out_info);
+
+// Write the index and trailer, sync and close the file and free the writer
+esp_err_t frame_pack_writer_finish(frame_pack_writer_handle_t writer, frame_pack_info_t *out_info);
+
+// Close and delete the unfinished pack and free the writer
+void frame_pack_writer_abort(frame_pack_writer_handle_t writer);
+
+// Check that path holds a finished pack and describe it. Returns
+// ESP_ERR_NOT_FOUND if there is no file and ESP_ERR_INVALID_RESPONSE if the
+// file is not a finished pack.
+esp_err_t frame_pack_read_info(const char *path, frame_pack_info_t *out_info);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,608 @@
+#include "frame_spool.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <esp_log.h>
+#include "crc32.h"
+
+static const char *TAG = "frame_spool";
+
+#define SEGMENT_MAGIC 0x4c505346  // "FSPL"
+#define RECORD_MAGIC  0x4d524652  // "RFRM"
+#define SPOOL_VERSION 1
+#define MAX_DIR_LEN   48
+#define MAX_PATH_LEN  (MAX_DIR_LEN + 16)
+
+// On-disk layout, little-endian: a segment header followed by records, each
+// a record header followed by the payload
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t id;
+    uint32_t header_crc;     // CRC of the preceding fields
+} segment_header_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t length;
+    int64_t timestamp_us;
+    uint32_t crc32;          // CRC of the payload
+    uint16_t width;
+    uint16_t height;
+    uint8_t format;
+    uint8_t flags;           // FRAME_SPOOL_FLAG_*
+    uint8_t reserved[2];
+    uint32_t header_crc;     // CRC of the preceding fields
+} record_header_t;
+
+_Static_assert(sizeof(segment_header_t) == 16, "segment header layout");
+_Static_assert(sizeof(record_header_t) == 32, "record header layout");
+
+struct frame_spool {
+    frame_spool_config_t config;
+    char dir[MAX_DIR_LEN];
+    uint32_t first_id;           // Oldest segment; reading always happens here
+    uint32_t last_id;            // Newest segment; appends go here
+    uint32_t segment_count;
+    uint32_t recovered_id;       // Records before this segment and offset were found on open
+    size_t recovered_end;
+    FILE *write_file;            // Open handle of last_id, NULL until the next append
+    size_t write_size;           // Size of last_id including batched bytes
+    uint8_t *wbuf;
+    size_t wfill;
+    bool unsynced;               // Bytes written since the last fsync
+    FILE *read_file;
+    size_t read_offset;
+    size_t read_end;
+    bool have_peek;
+    bool peek_oversized;
+    size_t peek_size;
+    uint32_t peek_length;
+    frame_spool_stats_t stats;
+};
+
+static void segment_path(const struct frame_spool *spool, uint32_t id, char *path)
+{
+    snprintf(path, MAX_PATH_LEN, "%s/%08" PRIu32 ".seg", spool->dir, id);
+}
+
+static bool record_header_valid(const record_header_t *hdr)
+{
+    return hdr->magic == RECORD_MAGIC &&
+           hdr->header_crc == crc32_update(0, hdr, offsetof(record_header_t, header_crc));
+}
+
+static bool segment_header_valid(const segment_header_t *hdr, uint32_t id)
+{
+    return hdr->magic == SEGMENT_MAGIC && hdr->version == SPOOL_VERSION && hdr->id == id &&
+           hdr->header_crc == crc32_update(0, hdr, offsetof(segment_header_t, header_crc));
+}
+
+static long file_size(FILE *f)
+{
+    if (fseek(f, 0, SEEK_END) != 0)
+    {
+        return -1;
+    }
+    return ftell(f);
+}
+
+// Walk the record headers of a segment from offset start and report where the
+// last intact record ends. Payload CRCs are only checked on replay.
+static esp_err_t scan_segment(struct frame_spool *spool, uint32_t id, size_t start, size_t *out_end,
+                              size_t *out_file_size, uint32_t *out_records, uint64_t *out_bytes)
+{
+    char path[MAX_PATH_LEN];
+    segment_header_t seg;
+    record_header_t hdr;
+
+    segment_path(spool, id, path);
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    long size = file_size(f);
+    if (size < (long)sizeof(seg) || fseek(f, 0, SEEK_SET) != 0 || fread(&seg, sizeof(seg), 1, f) != 1 ||
+        !segment_header_valid(&seg, id))
+    {
+        fclose(f);
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    size_t offset = start;
+    uint32_t records = 0;
+    uint64_t bytes = 0;
+    while (offset + sizeof(hdr) <= (size_t)size)
+    {
+        if (fseek(f, offset, SEEK_SET) != 0 || fread(&hdr, sizeof(hdr), 1, f) != 1 ||
+            !record_header_valid(&hdr) || offset + sizeof(hdr) + hdr.length > (size_t)size)
+        {
+            break;
+        }
+        records++;
+        bytes += hdr.length;
+        offset += sizeof(hdr) + hdr.length;
+    }
+    fclose(f);
+
+    *out_end = offset;
+    *out_file_size = size;
+    *out_records = records;
+    *out_bytes = bytes;
+    return ESP_OK;
+}
+
+static bool reading_write_segment(const struct frame_spool *spool)
+{
+    return spool->write_file && spool->first_id == spool->last_id;
+}
+
+// Delete the oldest segment and move the read position to the next one
+static void advance_read_segment(struct frame_spool *spool)
+{
+    char path[MAX_PATH_LEN];
+
+    if (spool->read_file)
+    {
+        fclose(spool->read_file);
+        spool->read_file = NULL;
+    }
+    if (reading_write_segment(spool))
+    {
+        fclose(spool->write_file);
+        spool->write_file = NULL;
+        spool->wfill = 0;
+        spool->write_size = 0;
+        spool->unsynced = false;
+    }
+
+    segment_path(spool, spool->first_id, path);
+    if ((remove(path) == 0 || errno != ENOENT) && spool->segment_count > 0)
+    {
+        spool->segment_count--;
+    }
+    spool->first_id++;
+    spool->read_offset = sizeof(segment_header_t);
+    spool->have_peek = false;
+    if (spool->segment_count == 0)
+    {
+        spool->first_id = spool->last_id + 1;
+    }
+}
+
+static esp_err_t write_bytes(struct frame_spool *spool, const void *data, size_t len)
+{
+    if (fwrite(data, 1, len, spool->write_file) != len)
+    {
+        ESP_LOGE(TAG, "Write failed: %s", strerror(errno));
+        return ESP_FAIL;
+    }
+    spool->stats.bytes_written += len;
+    spool->unsynced = true;
+    return ESP_OK;
+}
+
+esp_err_t frame_spool_flush(frame_spool_handle_t spool)
+{
+    if (!spool->write_file)
+    {
+        return ESP_OK;
+    }
+    if (spool->wfill > 0)
+    {
+        esp_err_t err = write_bytes(spool, spool->wbuf, spool->wfill);
+        spool->wfill = 0;
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+    }
+    if (!spool->unsynced)
+    {
+        return ESP_OK;
+    }
+    if (fflush(spool->write_file) != 0 || fsync(fileno(spool->write_file)) != 0)
+    {
+        return ESP_FAIL;
+    }
+    spool->unsynced = false;
+    return ESP_OK;
+}
+
+// Drop the unread records of the oldest segment to make room for a new one
+static void drop_oldest_segment(struct frame_spool *spool)
+{
+    size_t end, size;
+    uint32_t records = 0;
+    uint64_t bytes = 0;
+
+    if (reading_write_segment(spool))
+    {
+        frame_spool_flush(spool);
+    }
+    if (scan_segment(spool, spool->first_id, spool->read_offset, &end, &size, &records, &bytes) == ESP_OK)
+    {
+        spool->stats.dropped += records;
+        spool->stats.pending -= records < spool->stats.pending ? records : spool->stats.pending;
+        spool->stats.pending_bytes -= bytes < spool->stats.pending_bytes ? bytes : spool->stats.pending_bytes;
+        ESP_LOGW(TAG, "Spool full, dropped %" PRIu32 " frames", records);
+    }
+    advance_read_segment(spool);
+}
+
+static esp_err_t open_new_segment(struct frame_spool *spool)
+{
+    char path[MAX_PATH_LEN];
+    esp_err_t err;
+
+    if (spool->write_file)
+    {
+        if ((err = frame_spool_flush(spool)) != ESP_OK)
+        {
+            return err;
+        }
+        fclose(spool->write_file);
+        spool->write_file = NULL;
+    }
+    while (spool->segment_count >= spool->config.max_segments)
+    {
+        drop_oldest_segment(spool);
+    }
+
+    spool->last_id++;
+    if (spool->segment_count == 0)
+    {
+        spool->first_id = spool->last_id;
+        spool->read_offset = sizeof(segment_header_t);
+    }
+
+    segment_path(spool, spool->last_id, path);
+    spool->write_file = fopen(path, "wb");
+    if (!spool->write_file)
+    {
+        ESP_LOGE(TAG, "Failed to create %s: %s", path, strerror(errno));
+        return ESP_FAIL;
+    }
+    setvbuf(spool->write_file, NULL, _IONBF, 0);  // Batching happens in wbuf
+    spool->segment_count++;
+
+    segment_header_t seg = {
+        .magic = SEGMENT_MAGIC,
+        .version = SPOOL_VERSION,
+        .id = spool->last_id,
+    };
+    seg.header_crc = crc32_update(0, &seg, offsetof(segment_header_t, header_crc));
+    memcpy(spool->wbuf, &seg, sizeof(seg));
+    spool->wfill = sizeof(seg);
+    spool->write_size = sizeof(seg);
+    return ESP_OK;
+}
+
+esp_err_t frame_spool_open(const frame_spool_config_t *config, frame_spool_handle_t *out_spool)
+{
+    if (!config || !out_spool || !config->dir || strlen(config->dir) >= MAX_DIR_LEN ||
+        config->max_segments == 0 || config->write_buffer_size < sizeof(segment_header_t) ||
+        config->segment_size <= sizeof(segment_header_t) + sizeof(record_header_t))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct frame_spool *spool = calloc(1, sizeof(*spool));
+    if (!spool)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    spool->config = *config;
+    strcpy(spool->dir, config->dir);
+    spool->wbuf = malloc(config->write_buffer_size);
+    if (!spool->wbuf)
+    {
+        free(spool);
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (mkdir(spool->dir, 0755) != 0 && errno != EEXIST)
+    {
+        ESP_LOGW(TAG, "Could not create %s: %s", spool->dir, strerror(errno));
+    }
+    DIR *dir = opendir(spool->dir);
+    if (!dir)
+    {
+        ESP_LOGE(TAG, "Failed to open %s", spool->dir);
+        free(spool->wbuf);
+        free(spool);
+        return ESP_FAIL;
+    }
+
+    // Segment ids are consecutive, so the oldest and newest ids are all we need
+    uint32_t min_id = UINT32_MAX, max_id = 0;
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL)
+    {
+        uint32_t id;
+        char ext[4];
+        if (strlen(de->d_name) == 12 && sscanf(de->d_name, "%8" SCNu32 ".%3s", &id, ext) == 2 &&
+            strcasecmp(ext, "seg") == 0 && id > 0)
+        {
+            min_id = id < min_id ? id : min_id;
+            max_id = id > max_id ? id : max_id;
+        }
+    }
+    closedir(dir);
+
+    spool->first_id = 1;
+    spool->last_id = 0;
+    spool->read_offset = sizeof(segment_header_t);
+
+    if (max_id > 0)
+    {
+        spool->first_id = min_id;
+        spool->last_id = max_id;
+        // Appends after open go to a new segment, unless the newest one is reopened below
+        spool->recovered_id = max_id;
+        spool->recovered_end = SIZE_MAX;
+
+        for (uint32_t id = min_id; id <= max_id; id++)
+        {
+            char path[MAX_PATH_LEN];
+            size_t end, size;
+            uint32_t records;
+            uint64_t bytes;
+
+            segment_path(spool, id, path);
+            esp_err_t err = scan_segment(spool, id, sizeof(segment_header_t), &end, &size, &records, &bytes);
+            if (err == ESP_ERR_NOT_FOUND)
+            {
+                continue;
+            }
+            if (err != ESP_OK)
+            {
+                ESP_LOGW(TAG, "Removing corrupt segment %s", path);
+                remove(path);
+                continue;
+            }
+
+            if (id == max_id && end < size)
+            {
+                // Torn write from a power loss: cut back to the last intact record
+                ESP_LOGW(TAG, "Truncating %s from %zu to %zu bytes", path, size, end);
+                if (truncate(path, end) != 0)
+                {
+                    // Leave the file alone and start a fresh segment on the next append
+                    ESP_LOGE(TAG, "Truncate failed: %s", strerror(errno));
+                    size = 0;
+                }
+                else
+                {
+                    size = end;
+                }
+            }
+            if (id == max_id && size == end)
+            {
+                spool->write_file = fopen(path, "ab");
+                if (spool->write_file)
+                {
+                    setvbuf(spool->write_file, NULL, _IONBF, 0);
+                    spool->write_size = end;
+                    spool->recovered_end = end;
+                }
+            }
+
+            spool->segment_count++;
+            spool->stats.pending += records;
+            spool->stats.pending_bytes += bytes;
+        }
+
+        if (spool->segment_count == 0)
+        {
+            spool->first_id = spool->last_id + 1;
+        }
+        ESP_LOGI(TAG, "Recovered %" PRIu32 " frames in %" PRIu32 " segments",
+                 spool->stats.pending, spool->segment_count);
+    }
+
+    *out_spool = spool;
+    return ESP_OK;
+}
+
+esp_err_t frame_spool_append(frame_spool_handle_t spool, const frame_spool_entry_t *entry, const uint8_t *data)
+{
+    const size_t record_size = sizeof(record_header_t) + entry->length;
+    esp_err_t err;
+
+    if (sizeof(segment_header_t) + record_size > spool->config.segment_size)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (!spool->write_file || spool->write_size + record_size > spool->config.segment_size)
+    {
+        if ((err = open_new_segment(spool)) != ESP_OK)
+        {
+            return err;
+        }
+    }
+
+    record_header_t hdr = {
+        .magic = RECORD_MAGIC,
+        .length = entry->length,
+        .timestamp_us = entry->timestamp_us,
+        .crc32 = crc32_update(0, data, entry->length),
+        .width = entry->width,
+        .height = entry->height,
+        .format = entry->format,
+        .flags = entry->flags,
+    };
+    hdr.header_crc = crc32_update(0, &hdr, offsetof(record_header_t, header_crc));
+
+    if (spool->wfill + record_size > spool->config.write_buffer_size &&
+        (err = frame_spool_flush(spool)) != ESP_OK)
+    {
+        return err;
+    }
+    if (record_size <= spool->config.write_buffer_size)
+    {
+        memcpy(spool->wbuf + spool->wfill, &hdr, sizeof(hdr));
+        memcpy(spool->wbuf + spool->wfill + sizeof(hdr), data, entry->length);
+        spool->wfill += record_size;
+    }
+    else if ((err = write_bytes(spool, &hdr, sizeof(hdr))) != ESP_OK ||
+             (err = write_bytes(spool, data, entry->length)) != ESP_OK)
+    {
+        return err;
+    }
+
+    spool->write_size += record_size;
+    spool->stats.appended++;
+    spool->stats.pending++;
+    spool->stats.pending_bytes += entry->length;
+    spool->stats.payload_bytes += entry->length;
+    return ESP_OK;
+}
+
+esp_err_t frame_spool_peek(frame_spool_handle_t spool, frame_spool_entry_t *out_entry,
+                           uint8_t *buf, size_t capacity)
+{
+    char path[MAX_PATH_LEN];
+    record_header_t hdr;
+
+    spool->have_peek = false;
+    while (spool->stats.pending > 0 && spool->segment_count > 0)
+    {
+        if (reading_write_segment(spool) && spool->wfill > 0)
+        {
+            esp_err_t err = frame_spool_flush(spool);
+            if (err != ESP_OK)
+            {
+                return err;
+            }
+        }
+
+        if (spool->read_file && reading_write_segment(spool) && spool->read_end < spool->write_size)
+        {
+            // FATFS fixes a file's size when it is opened, so reopen to see new appends
+            fclose(spool->read_file);
+            spool->read_file = NULL;
+        }
+        if (!spool->read_file)
+        {
+            segment_path(spool, spool->first_id, path);
+            spool->read_file = fopen(path, "rb");
+            if (!spool->read_file)
+            {
+                advance_read_segment(spool);  // Missing segment; it was removed on open
+                continue;
+            }
+            long size = file_size(spool->read_file);
+            spool->read_end = size > 0 ? size : 0;
+        }
+        size_t end = reading_write_segment(spool) ? spool->write_size : spool->read_end;
+        size_t offset = spool->read_offset;
+
+        if (offset + sizeof(hdr) > end || fseek(spool->read_file, offset, SEEK_SET) != 0 ||
+            fread(&hdr, sizeof(hdr), 1, spool->read_file) != 1 || !record_header_valid(&hdr) ||
+            offset + sizeof(hdr) + hdr.length > end)
+        {
+            if (reading_write_segment(spool))
+            {
+                return ESP_ERR_NOT_FOUND;
+            }
+            advance_read_segment(spool);  // End of this segment, or a corrupt tail
+            continue;
+        }
+
+        out_entry->timestamp_us = hdr.timestamp_us;
+        out_entry->length = hdr.length;
+        out_entry->width = hdr.width;
+        out_entry->height = hdr.height;
+        out_entry->format = hdr.format;
+        out_entry->flags = hdr.flags;
+        out_entry->recovered = spool->first_id < spool->recovered_id ||
+                               (spool->first_id == spool->recovered_id && offset < spool->recovered_end);
+        spool->peek_size = sizeof(hdr) + hdr.length;
+        spool->peek_length = hdr.length;
+        spool->have_peek = true;
+
+        if (hdr.length > capacity)
+        {
+            spool->peek_oversized = true;
+            return ESP_ERR_INVALID_SIZE;
+        }
+        spool->peek_oversized = false;
+
+        if (fread(buf, 1, hdr.length, spool->read_file) != hdr.length ||
+            crc32_update(0, buf, hdr.length) != hdr.crc32)
+        {
+            ESP_LOGW(TAG, "Dropping corrupt frame in segment %" PRIu32, spool->first_id);
+            spool->peek_oversized = true;  // Consume it as dropped rather than replayed
+            frame_spool_consume(spool);
+            continue;
+        }
+        return ESP_OK;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t frame_spool_consume(frame_spool_handle_t spool)
+{
+    if (!spool->have_peek)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    spool->have_peek = false;
+    spool->read_offset += spool->peek_size;
+    spool->stats.pending--;
+    spool->stats.pending_bytes -= spool->peek_length;
+    if (spool->peek_oversized)
+    {
+        spool->stats.dropped++;
+    }
+    else
+    {
+        spool->stats.replayed++;
+    }
+
+    // Fully replayed segments are deleted, including the newest one once it is
+    // drained, so an idle spool takes no flash at all
+    size_t end = reading_write_segment(spool) ? spool->write_size : spool->read_end;
+    if (spool->read_offset >= end)
+    {
+        advance_read_segment(spool);
+    }
+    return ESP_OK;
+}
+
+void frame_spool_get_stats(frame_spool_handle_t spool, frame_spool_stats_t *out_stats)
+{
+    *out_stats = spool->stats;
+    out_stats->segments = spool->segment_count;
+}
+
+void frame_spool_close(frame_spool_handle_t spool)
+{
+    if (!spool)
+    {
+        return;
+    }
+    frame_spool_flush(spool);
+    if (spool->write_file)
+    {
+        fclose(spool->write_file);
+    }
+    if (spool->read_file)
+    {
+        fclose(spool->read_file);
+    }
+    free(spool->wbuf);
+    free(spool);
+}
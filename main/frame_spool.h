@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Append-only store-and-forward spool for frames that could not be uploaded.
+// Frames are appended as CRC-protected records to fixed-size segment files in
+// a directory, and replayed oldest first. Only plain stdio/POSIX file calls are
+// used, so the same code runs on the FATFS partition and on a host directory.
+//
+// Durability: records are batched in RAM and reach the file on
+// frame_spool_flush() or when the batch buffer fills. After a power loss a torn
+// record at the end of the newest segment is detected and truncated on open.
+// Consumption is tracked in RAM and segments are deleted once fully replayed,
+// so frames from a partially replayed segment may be replayed again after a
+// reboot (at-least-once delivery).
+
+// timestamp_us is microseconds since boot (esp_timer) rather than wall-clock
+// time, because the clock was not set yet when the frame was captured
+#define FRAME_SPOOL_FLAG_BOOT_TIME 0x01
+
+typedef struct {
+    int64_t timestamp_us;   // Capture time, wall clock unless flagged otherwise
+    uint32_t length;        // Payload size in bytes
+    uint16_t width;
+    uint16_t height;
+    uint8_t format;         // frame_format_t of the payload
+    uint8_t flags;          // FRAME_SPOOL_FLAG_*, stored with the record
+    bool recovered;         // Set by peek: the record was already on disk at open, i.e. from an earlier boot
+} frame_spool_entry_t;
+
+typedef struct {
+    const char *dir;            // Directory for the segment files (must exist or be creatable)
+    size_t segment_size;        // Maximum size of one segment file
+    uint32_t max_segments;      // Flash budget is segment_size * max_segments
+    size_t write_buffer_size;   // Records are batched into writes of up to this size
+} frame_spool_config_t;
+
+typedef struct {
+    uint32_t pending;           // Records waiting to be replayed
+    uint64_t pending_bytes;     // Payload bytes waiting to be replayed
+    uint32_t appended;
+    uint32_t replayed;
+    uint32_t dropped;           // Records discarded to stay in budget or found corrupt
+    uint32_t segments;          // Segment files currently on disk
+    uint64_t payload_bytes;     // Payload bytes appended
+    uint64_t bytes_written;     // Bytes written to the files, headers included
+} frame_spool_stats_t;
+
+typedef struct frame_spool *frame_spool_handle_t;
+
+// Open the spool, recovering existing segments and truncating a torn tail
+esp_err_t frame_spool_open(const frame_spool_config_t *config, frame_spool_handle_t *out_spool);
+
+// Append one record. If the flash budget is exhausted the oldest segment is dropped.
+esp_err_t frame_spool_append(frame_spool_handle_t spool, const frame_spool_entry_t *entry, const uint8_t *data);
+
+// Write batched records to the file and sync it
+esp_err_t frame_spool_flush(frame_spool_handle_t spool);
+
+// Read the oldest pending record without consuming it. Returns ESP_ERR_NOT_FOUND
+// when the spool is empty and ESP_ERR_INVALID_SIZE (with out_entry filled in)
+// if the payload does not fit; consume it to skip it.
+esp_err_t frame_spool_peek(frame_spool_handle_t spool, frame_spool_entry_t *out_entry,
+                           uint8_t *buf, size_t capacity);
+
+// Mark the record returned by the last peek as delivered
+esp_err_t frame_spool_consume(frame_spool_handle_t spool);
+
+void frame_spool_get_stats(frame_spool_handle_t spool, frame_spool_stats_t *out_stats);
+
+// Flush and close the spool
+void frame_spool_close(frame_spool_handle_t spool);
+
+#ifdef __cplusplus
+}
+#endif
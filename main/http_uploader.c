@@ -0,0 +1,731 @@
+#include "http_uploader.h"
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <sys/select.h>
+#include <netinet/tcp.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_tls.h>
+#include "sdkconfig.h"
+#include "metrics.h"
+
+static const char *TAG = "http_uploader";
+
+#define HEAD_BUF_SIZE 2048  // Request line and headers; presigned URLs are long
+#define RX_BUF_SIZE   512
+#define LINE_BUF_SIZE 256   // Longer response header lines are truncated
+#define MAX_HOST_LEN  128
+
+struct http_uploader {
+    http_uploader_config_t config;
+    esp_tls_t *tls;                  // NULL while disconnected
+    bool https;
+    char host[MAX_HOST_LEN];
+    int port;
+    int64_t last_used_us;
+    bool reused;                     // The current request runs on an earlier connection
+    bool in_request;
+    size_t content_length;
+    size_t body_sent;
+    int64_t send_start_us;           // When the request head started going out
+    uint8_t *chunk_buf;
+    size_t chunk_fill;
+    char *head_buf;
+    uint8_t rx_buf[RX_BUF_SIZE];
+    size_t rx_pos;
+    size_t rx_len;
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    esp_tls_client_session_t *session;
+#endif
+    http_uploader_stats_t stats;
+};
+
+esp_err_t http_uploader_create(const http_uploader_config_t *config, http_uploader_handle_t *out_uploader)
+{
+    if (!config || !out_uploader || config->chunk_size == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct http_uploader *up = calloc(1, sizeof(*up));
+    if (!up)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    up->config = *config;
+    up->chunk_buf = malloc(config->chunk_size);
+    up->head_buf = malloc(HEAD_BUF_SIZE);
+    if (!up->chunk_buf || !up->head_buf)
+    {
+        http_uploader_delete(up);
+        return ESP_ERR_NO_MEM;
+    }
+
+    *out_uploader = up;
+    return ESP_OK;
+}
+
+static void close_connection(struct http_uploader *up)
+{
+    if (up->tls)
+    {
+        esp_tls_conn_destroy(up->tls);
+        up->tls = NULL;
+    }
+    up->rx_pos = up->rx_len = 0;
+}
+
+static void forget_session(struct http_uploader *up)
+{
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    if (up->session)
+    {
+        esp_tls_free_client_session(up->session);
+        up->session = NULL;
+    }
+#endif
+}
+
+void http_uploader_delete(http_uploader_handle_t uploader)
+{
+    if (!uploader)
+    {
+        return;
+    }
+    close_connection(uploader);
+    forget_session(uploader);
+    free(uploader->chunk_buf);
+    free(uploader->head_buf);
+    free(uploader);
+}
+
+void http_uploader_get_stats(http_uploader_handle_t uploader, http_uploader_stats_t *out_stats)
+{
+    *out_stats = uploader->stats;
+}
+
+// Split "scheme://host[:port]/path?query" into its parts; *out_path points into url
+static esp_err_t parse_url(const char *url, bool *out_https, char *host, size_t host_size,
+                           int *out_port, const char **out_path)
+{
+    const char *p;
+
+    if (strncmp(url, "https://", 8) == 0)
+    {
+        *out_https = true;
+        *out_port = 443;
+        p = url + 8;
+    }
+    else if (strncmp(url, "http://", 7) == 0)
+    {
+        *out_https = false;
+        *out_port = 80;
+        p = url + 7;
+    }
+    else
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t host_len = strcspn(p, ":/?");
+    if (host_len == 0 || host_len >= host_size)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memcpy(host, p, host_len);
+    host[host_len] = '\0';
+    p += host_len;
+
+    if (*p == ':')
+    {
+        *out_port = (int)strtol(p + 1, (char **)&p, 10);
+        if (*out_port <= 0 || *out_port > 65535)
+        {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    *out_path = p;
+    return ESP_OK;
+}
+
+static esp_err_t open_connection(struct http_uploader *up)
+{
+    int64_t start = esp_timer_get_time();
+
+    // Resolve on our own so DNS is measured apart from the connect, then hand
+    // esp_tls the numeric address so it does not look the name up again
+    struct addrinfo hints = {
+        .ai_socktype = SOCK_STREAM,
+    };
+    struct addrinfo *res = NULL;
+    char addr[INET6_ADDRSTRLEN];
+    const void *sin_addr = NULL;
+    if (getaddrinfo(up->host, NULL, &hints, &res) == 0 && res)
+    {
+        if (res->ai_family == AF_INET)
+        {
+            sin_addr = &((const struct sockaddr_in *)res->ai_addr)->sin_addr;
+        }
+        else if (res->ai_family == AF_INET6)
+        {
+            sin_addr = &((const struct sockaddr_in6 *)res->ai_addr)->sin6_addr;
+        }
+    }
+    if (!sin_addr || !inet_ntop(res->ai_family, sin_addr, addr, sizeof(addr)))
+    {
+        ESP_LOGE(TAG, "Failed to resolve %s", up->host);
+        metrics_record_error(METRIC_DNS);
+        if (res)
+        {
+            freeaddrinfo(res);
+        }
+        return ESP_FAIL;
+    }
+    freeaddrinfo(res);
+    int64_t resolved = esp_timer_get_time();
+    metrics_record(METRIC_DNS, resolved - start);
+
+    esp_tls_cfg_t cfg = {
+        .timeout_ms = up->config.timeout_ms,
+        .is_plain_tcp = !up->https,
+        .common_name = up->host,  // SNI and certificate check still use the name
+    };
+    if (up->https && up->config.cert_pem)
+    {
+        cfg.cacert_pem_buf = (const unsigned char *)up->config.cert_pem;
+        cfg.cacert_pem_bytes = strlen(up->config.cert_pem) + 1;
+    }
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    if (up->https)
+    {
+        cfg.client_session = up->session;  // Resume instead of a full handshake when possible
+    }
+#endif
+
+    up->tls = esp_tls_init();
+    if (!up->tls)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    if (esp_tls_conn_new_sync(addr, strlen(addr), up->port, &cfg, up->tls) != 1)
+    {
+        ESP_LOGE(TAG, "Failed to connect to %s:%d", up->host, up->port);
+        metrics_record_error(METRIC_CONNECT);
+        close_connection(up);
+        return ESP_FAIL;
+    }
+
+    // Bodies already go out in whole chunks; Nagle would only hold back the
+    // short tail of each request until the server's delayed ACK
+    int fd;
+    int nodelay = 1;
+    if (esp_tls_get_conn_sockfd(up->tls, &fd) == ESP_OK)
+    {
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    }
+
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    if (up->https)
+    {
+        forget_session(up);
+        up->session = esp_tls_get_client_session(up->tls);
+    }
+#endif
+
+    metrics_since(METRIC_CONNECT, resolved);
+    up->stats.connections++;
+    up->stats.last_connect_us = esp_timer_get_time() - start;
+    up->stats.connect_time_us += up->stats.last_connect_us;
+    ESP_LOGD(TAG, "Connected to %s:%d in %lld us", up->host, up->port, (long long)up->stats.last_connect_us);
+    return ESP_OK;
+}
+
+// Block until the socket is ready for what esp_tls asked for (TLS may need to
+// read in the middle of a write and the other way round), up to the timeout
+static esp_err_t wait_socket(struct http_uploader *up, ssize_t want)
+{
+    int fd;
+    if (esp_tls_get_conn_sockfd(up->tls, &fd) != ESP_OK || fd < 0)
+    {
+        return ESP_FAIL;
+    }
+
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(fd, &fds);
+    struct timeval tv = {
+        .tv_sec = up->config.timeout_ms / 1000,
+        .tv_usec = (up->config.timeout_ms % 1000) * 1000,
+    };
+    bool readable = want == ESP_TLS_ERR_SSL_WANT_READ;
+    int n = select(fd + 1, readable ? &fds : NULL, readable ? NULL : &fds, NULL, &tv);
+    if (n == 0)
+    {
+        ESP_LOGW(TAG, "No progress on the connection for %d ms", up->config.timeout_ms);
+        return ESP_ERR_TIMEOUT;
+    }
+    return n > 0 ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t send_all(struct http_uploader *up, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+
+    while (len > 0)
+    {
+        ssize_t n = esp_tls_conn_write(up->tls, p, len);
+        if (n == ESP_TLS_ERR_SSL_WANT_READ || n == ESP_TLS_ERR_SSL_WANT_WRITE)
+        {
+            esp_err_t err = wait_socket(up, n);
+            if (err != ESP_OK)
+            {
+                return err;
+            }
+            continue;
+        }
+        if (n <= 0)
+        {
+            return ESP_FAIL;
+        }
+        p += n;
+        len -= n;
+        up->stats.bytes_sent += n;
+    }
+    return ESP_OK;
+}
+
+static void abort_request(struct http_uploader *up)
+{
+    close_connection(up);
+    up->in_request = false;
+}
+
+esp_err_t http_uploader_begin(http_uploader_handle_t uploader, const char *url, const char *content_type,
+                              const char *extra_headers, size_t content_length)
+{
+    struct http_uploader *up = uploader;
+    char host[MAX_HOST_LEN];
+    const char *path;
+    bool https;
+    int port;
+
+    if (!up || !url || !content_type)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (up->in_request)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = parse_url(url, &https, host, sizeof(host), &port, &path);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Unsupported URL");
+        return err;
+    }
+
+    // A connection can only be reused for the same origin, and servers drop idle ones
+    bool same_origin = https == up->https && port == up->port && strcmp(host, up->host) == 0;
+    bool idle_expired = esp_timer_get_time() - up->last_used_us > (int64_t)up->config.idle_timeout_ms * 1000;
+    if (up->tls && (!same_origin || idle_expired))
+    {
+        close_connection(up);
+    }
+    if (!same_origin)
+    {
+        forget_session(up);
+        strcpy(up->host, host);
+        up->https = https;
+        up->port = port;
+    }
+
+    char host_header[MAX_HOST_LEN + 8];
+    if (port == (https ? 443 : 80))
+    {
+        snprintf(host_header, sizeof(host_header), "%s", host);
+    }
+    else
+    {
+        snprintf(host_header, sizeof(host_header), "%s:%d", host, port);
+    }
+
+    int head_len = snprintf(up->head_buf, HEAD_BUF_SIZE,
+                            "PUT %s%s HTTP/1.1\r\n"
+                            "Host: %s\r\n"
+                            "Content-Type: %s\r\n"
+                            "Connection: keep-alive\r\n"
+                            "Content-Length: %zu\r\n",
+                            *path == '/' ? "" : "/", path, host_header, content_type, content_length);
+    if (head_len > 0 && head_len < HEAD_BUF_SIZE)
+    {
+        head_len += snprintf(up->head_buf + head_len, HEAD_BUF_SIZE - head_len, "%s\r\n",
+                             extra_headers ? extra_headers : "");
+    }
+    if (head_len <= 0 || head_len >= HEAD_BUF_SIZE)
+    {
+        ESP_LOGE(TAG, "Request head does not fit in %d bytes", HEAD_BUF_SIZE);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    up->reused = up->tls != NULL;
+    if (!up->tls && (err = open_connection(up)) != ESP_OK)
+    {
+        return err;
+    }
+
+    up->send_start_us = esp_timer_get_time();
+    err = send_all(up, up->head_buf, head_len);
+    if (err != ESP_OK && up->reused)
+    {
+        // Nothing of this request has reached the server yet, so simply reconnect
+        ESP_LOGD(TAG, "Reused connection was closed, reconnecting");
+        close_connection(up);
+        up->reused = false;
+        if ((err = open_connection(up)) == ESP_OK)
+        {
+            up->send_start_us = esp_timer_get_time();
+            err = send_all(up, up->head_buf, head_len);
+        }
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to send request head");
+        metrics_record_error(METRIC_SEND);
+        close_connection(up);
+        return err;
+    }
+
+    up->stats.requests++;
+    up->in_request = true;
+    up->content_length = content_length;
+    up->body_sent = 0;
+    up->chunk_fill = 0;
+    return ESP_OK;
+}
+
+static esp_err_t send_chunk(struct http_uploader *up, const uint8_t *data, size_t len)
+{
+    if (len > up->content_length - up->body_sent)
+    {
+        ESP_LOGE(TAG, "Body is longer than the announced %zu bytes", up->content_length);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    esp_err_t err = send_all(up, data, len);
+    if (err == ESP_OK)
+    {
+        up->body_sent += len;
+    }
+    return err;
+}
+
+esp_err_t http_uploader_write(http_uploader_handle_t uploader, const uint8_t *data, size_t len)
+{
+    struct http_uploader *up = uploader;
+    const size_t chunk_size = up->config.chunk_size;
+
+    if (!up->in_request)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    while (len > 0)
+    {
+        esp_err_t err = ESP_OK;
+
+        if (up->chunk_fill == 0 && len >= chunk_size)
+        {
+            // Whole chunks go straight from the caller's buffer
+            err = send_chunk(up, data, chunk_size);
+            data += chunk_size;
+            len -= chunk_size;
+        }
+        else
+        {
+            size_t n = chunk_size - up->chunk_fill;
+            n = n < len ? n : len;
+            memcpy(up->chunk_buf + up->chunk_fill, data, n);
+            up->chunk_fill += n;
+            data += n;
+            len -= n;
+            if (up->chunk_fill == chunk_size)
+            {
+                err = send_chunk(up, up->chunk_buf, chunk_size);
+                up->chunk_fill = 0;
+            }
+        }
+
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Failed to send request body");
+            metrics_record_error(METRIC_SEND);
+            abort_request(up);
+            return err;
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t read_byte(struct http_uploader *up, uint8_t *out)
+{
+    while (up->rx_pos >= up->rx_len)
+    {
+        ssize_t n = esp_tls_conn_read(up->tls, up->rx_buf, sizeof(up->rx_buf));
+        if (n == ESP_TLS_ERR_SSL_WANT_READ || n == ESP_TLS_ERR_SSL_WANT_WRITE)
+        {
+            esp_err_t err = wait_socket(up, n);
+            if (err != ESP_OK)
+            {
+                return err;
+            }
+            continue;
+        }
+        if (n <= 0)
+        {
+            return n == 0 ? ESP_ERR_INVALID_STATE : ESP_FAIL;  // Closed by the server / error
+        }
+        up->rx_pos = 0;
+        up->rx_len = n;
+    }
+    *out = up->rx_buf[up->rx_pos++];
+    return ESP_OK;
+}
+
+// Read one CRLF-terminated line without the terminator, lower-casing it
+static esp_err_t read_line(struct http_uploader *up, char *line, size_t size)
+{
+    size_t len = 0;
+    uint8_t c;
+
+    for (;;)
+    {
+        esp_err_t err = read_byte(up, &c);
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+        if (c == '\n')
+        {
+            break;
+        }
+        if (c != '\r' && len + 1 < size)
+        {
+            line[len++] = tolower(c);
+        }
+    }
+    line[len] = '\0';
+    return ESP_OK;
+}
+
+static esp_err_t discard_bytes(struct http_uploader *up, int64_t len)
+{
+    while (len > 0)
+    {
+        if (up->rx_pos >= up->rx_len)
+        {
+            uint8_t c;
+            esp_err_t err = read_byte(up, &c);
+            if (err != ESP_OK)
+            {
+                return err;
+            }
+            len--;
+            continue;
+        }
+        size_t n = up->rx_len - up->rx_pos;
+        n = (int64_t)n < len ? n : (size_t)len;
+        up->rx_pos += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t discard_chunked_body(struct http_uploader *up)
+{
+    char line[LINE_BUF_SIZE];
+    esp_err_t err;
+
+    for (;;)
+    {
+        if ((err = read_line(up, line, sizeof(line))) != ESP_OK)
+        {
+            return err;
+        }
+        long size = strtol(line, NULL, 16);
+        if (size <= 0)
+        {
+            break;
+        }
+        if ((err = discard_bytes(up, size)) != ESP_OK ||
+            (err = read_line(up, line, sizeof(line))) != ESP_OK)
+        {
+            return err;
+        }
+    }
+
+    // Trailer section ends with an empty line
+    do
+    {
+        if ((err = read_line(up, line, sizeof(line))) != ESP_OK)
+        {
+            return err;
+        }
+    } while (line[0] != '\0');
+    return ESP_OK;
+}
+
+static esp_err_t read_response(struct http_uploader *up, int *out_status)
+{
+    char line[LINE_BUF_SIZE];
+    esp_err_t err;
+
+    if ((err = read_line(up, line, sizeof(line))) != ESP_OK)
+    {
+        return err;
+    }
+    if (strncmp(line, "http/1.", 7) != 0 || strlen(line) < 12)
+    {
+        ESP_LOGE(TAG, "Malformed status line");
+        return ESP_FAIL;
+    }
+    bool keep_alive = line[7] == '1';
+    int status = atoi(line + 9);
+
+    int64_t content_length = -1;
+    bool chunked = false;
+    for (;;)
+    {
+        if ((err = read_line(up, line, sizeof(line))) != ESP_OK)
+        {
+            return err;
+        }
+        if (line[0] == '\0')
+        {
+            break;
+        }
+        if (strncmp(line, "content-length:", 15) == 0)
+        {
+            content_length = strtoll(line + 15, NULL, 10);
+        }
+        else if (strncmp(line, "transfer-encoding:", 18) == 0)
+        {
+            chunked = strstr(line + 18, "chunked") != NULL;
+        }
+        else if (strncmp(line, "connection:", 11) == 0)
+        {
+            keep_alive = strstr(line + 11, "close") == NULL;
+        }
+    }
+
+    if (status == 204 || status == 304)
+    {
+        err = ESP_OK;
+    }
+    else if (chunked)
+    {
+        err = discard_chunked_body(up);
+    }
+    else if (content_length >= 0)
+    {
+        err = discard_bytes(up, content_length);
+    }
+    else
+    {
+        keep_alive = false;  // Body runs until the server closes the connection
+    }
+
+    if (err != ESP_OK || !keep_alive)
+    {
+        close_connection(up);
+    }
+    *out_status = status;
+    return err;
+}
+
+esp_err_t http_uploader_finish(http_uploader_handle_t uploader, int *out_status)
+{
+    struct http_uploader *up = uploader;
+    esp_err_t err = ESP_OK;
+    int status = 0;
+
+    if (!up->in_request)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (up->chunk_fill > 0)
+    {
+        err = send_chunk(up, up->chunk_buf, up->chunk_fill);
+        up->chunk_fill = 0;
+    }
+    if (err == ESP_OK && up->body_sent != up->content_length)
+    {
+        ESP_LOGE(TAG, "Body ended after %zu of %zu bytes", up->body_sent, up->content_length);
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    if (err == ESP_OK)
+    {
+        int64_t sent = esp_timer_get_time();
+        metrics_record(METRIC_SEND, sent - up->send_start_us);
+        err = read_response(up, &status);
+        if (err == ESP_OK)
+        {
+            metrics_since(METRIC_RESPONSE, sent);
+        }
+        else
+        {
+            metrics_record_error(METRIC_RESPONSE);
+        }
+    }
+    else
+    {
+        metrics_record_error(METRIC_SEND);
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Request failed: %s", esp_err_to_name(err));
+        abort_request(up);
+        return err;
+    }
+
+    up->in_request = false;
+    up->last_used_us = esp_timer_get_time();
+    if (out_status)
+    {
+        *out_status = status;
+    }
+    return ESP_OK;
+}
+
+esp_err_t http_uploader_put(http_uploader_handle_t uploader, const char *url, const char *content_type,
+                            const char *extra_headers, const uint8_t *data, size_t len, int *out_status)
+{
+    esp_err_t err = ESP_FAIL;
+
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        err = http_uploader_begin(uploader, url, content_type, extra_headers, len);
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+        bool reused = uploader->reused;
+
+        err = http_uploader_write(uploader, data, len);
+        if (err == ESP_OK)
+        {
+            err = http_uploader_finish(uploader, out_status);
+        }
+        if (err == ESP_OK || !reused)
+        {
+            break;
+        }
+        ESP_LOGW(TAG, "Reused connection failed mid-request, retrying on a new one");
+    }
+    return err;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Long-lived HTTP/1.1 PUT client. The connection (and, for https, the TLS
+// session ticket) is kept between requests, and bodies are streamed in
+// fixed-size chunks so they never need to sit in one contiguous buffer.
+// The length is always announced up front with Content-Length: S3 rejects
+// plain chunked transfer encoding on PUT, and every body this firmware sends
+// (a frame buffer or a pack file) has a known size before it is sent.
+
+typedef struct {
+    size_t chunk_size;         // Bytes per socket write of the request body
+    int timeout_ms;            // Connect/read/write timeout
+    int idle_timeout_ms;       // Reconnect instead of reusing a connection idle for longer
+    const char *cert_pem;      // CA certificate for https, NULL to use the global settings
+} http_uploader_config_t;
+
+typedef struct {
+    uint32_t requests;         // Requests started
+    uint32_t connections;      // Connections opened (the rest reused a live one)
+    uint64_t connect_time_us;  // Total time spent in DNS, TCP and TLS setup
+    int64_t last_connect_us;   // Setup time of the most recent connection
+    uint64_t bytes_sent;       // Request heads and bodies on the wire
+} http_uploader_stats_t;
+
+typedef struct http_uploader *http_uploader_handle_t;
+
+esp_err_t http_uploader_create(const http_uploader_config_t *config, http_uploader_handle_t *out_uploader);
+
+// Send the request head of a PUT to url. extra_headers, if not NULL, is a block
+// of complete "Name: value\r\n" lines. Exactly content_length body bytes must
+// follow.
+esp_err_t http_uploader_begin(http_uploader_handle_t uploader, const char *url, const char *content_type,
+                              const char *extra_headers, size_t content_length);
+
+// Append body bytes; they go out on the socket every chunk_size bytes
+esp_err_t http_uploader_write(http_uploader_handle_t uploader, const uint8_t *data, size_t len);
+
+// Send the rest of the body and read the response. The connection is kept for
+// the next request unless the server asked to close it.
+esp_err_t http_uploader_finish(http_uploader_handle_t uploader, int *out_status);
+
+// PUT a complete buffer. Retries once on a fresh connection if a reused one
+// turns out to have been closed by the server.
+esp_err_t http_uploader_put(http_uploader_handle_t uploader, const char *url, const char *content_type,
+                            const char *extra_headers, const uint8_t *data, size_t len, int *out_status);
+
+void http_uploader_get_stats(http_uploader_handle_t uploader, http_uploader_stats_t *out_stats);
+
+void http_uploader_delete(http_uploader_handle_t uploader);
+
+#ifdef __cplusplus
+}
+#endif
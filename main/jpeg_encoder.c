@@ -0,0 +1,571 @@
+#include "jpeg_encoder.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Chroma is subsampled 2x2, so one MCU covers 16x16 pixels: four luma blocks
+// followed by one Cb and one Cr block.
+#define MCU_SIZE 16
+
+typedef struct {
+    uint16_t code[256];
+    uint8_t size[256];
+} huff_table_t;
+
+struct jpeg_encoder {
+    uint16_t max_width;
+    uint16_t max_height;
+    volatile int requested_quality;  // Set from any task, applied at the next encode
+    int quality;
+    uint8_t qt_luma[64];             // Quantization tables in zigzag order
+    uint8_t qt_chroma[64];
+    float fdtbl_luma[64];            // Reciprocal quantizers with the AAN scaling folded in
+    float fdtbl_chroma[64];
+    huff_table_t dc_luma, ac_luma, dc_chroma, ac_chroma;
+    // One MCU row of converted pixels; width padded to a multiple of MCU_SIZE
+    size_t strip_width;
+    uint8_t *y_strip;                // strip_width x 16
+    uint8_t *cb_strip;               // strip_width x 16, subsampled in place
+    uint8_t *cr_strip;
+};
+
+typedef struct {
+    uint8_t *out;
+    size_t capacity;
+    size_t pos;
+    uint32_t bits;
+    int nbits;
+    bool overflow;
+} bit_writer_t;
+
+static const uint8_t zigzag_to_natural[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+// ITU T.81 Annex K quantization tables, natural order
+static const uint8_t base_qt_luma[64] = {
+    16, 11, 10, 16,  24,  40,  51,  61,
+    12, 12, 14, 19,  26,  58,  60,  55,
+    14, 13, 16, 24,  40,  57,  69,  56,
+    14, 17, 22, 29,  51,  87,  80,  62,
+    18, 22, 37, 56,  68, 109, 103,  77,
+    24, 35, 55, 64,  81, 104, 113,  92,
+    49, 64, 78, 87, 103, 121, 120, 101,
+    72, 92, 95, 98, 112, 100, 103,  99,
+};
+
+static const uint8_t base_qt_chroma[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99,
+    18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99,
+    47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+};
+
+// ITU T.81 Annex K Huffman tables: code counts per length 1..16, then symbols
+static const uint8_t dc_luma_bits[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+static const uint8_t dc_luma_vals[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+static const uint8_t dc_chroma_bits[16] = {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0};
+static const uint8_t dc_chroma_vals[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+
+static const uint8_t ac_luma_bits[16] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d};
+static const uint8_t ac_luma_vals[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+    0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+    0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa,
+};
+
+static const uint8_t ac_chroma_bits[16] = {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77};
+static const uint8_t ac_chroma_vals[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+    0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+    0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa,
+};
+
+static const float aan_scale[8] = {
+    1.0f, 1.387039845f, 1.306562965f, 1.175875602f,
+    1.0f, 0.785694958f, 0.541196100f, 0.275899379f,
+};
+
+static void build_huff_table(huff_table_t *table, const uint8_t bits[16], const uint8_t *vals)
+{
+    uint16_t code = 0;
+    size_t k = 0;
+
+    memset(table, 0, sizeof(*table));
+    for (int len = 1; len <= 16; len++)
+    {
+        for (int i = 0; i < bits[len - 1]; i++)
+        {
+            uint8_t sym = vals[k++];
+            table->code[sym] = code++;
+            table->size[sym] = len;
+        }
+        code <<= 1;
+    }
+}
+
+// Scale the Annex K tables the same way libjpeg does so quality values match
+static void build_quant_tables(struct jpeg_encoder *enc, int quality)
+{
+    int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+
+    for (int i = 0; i < 64; i++)
+    {
+        int n = zigzag_to_natural[i];
+        int ql = (base_qt_luma[n] * scale + 50) / 100;
+        int qc = (base_qt_chroma[n] * scale + 50) / 100;
+        ql = ql < 1 ? 1 : ql > 255 ? 255 : ql;
+        qc = qc < 1 ? 1 : qc > 255 ? 255 : qc;
+        enc->qt_luma[i] = ql;
+        enc->qt_chroma[i] = qc;
+
+        // The AAN DCT leaves every coefficient scaled by 8 * aan[row] * aan[col]
+        float aan = 8.0f * aan_scale[n >> 3] * aan_scale[n & 7];
+        enc->fdtbl_luma[n] = 1.0f / (ql * aan);
+        enc->fdtbl_chroma[n] = 1.0f / (qc * aan);
+    }
+    enc->quality = quality;
+}
+
+esp_err_t jpeg_encoder_create(uint16_t max_width, uint16_t max_height, int quality,
+                              jpeg_encoder_handle_t *out_encoder)
+{
+    if (!out_encoder || max_width == 0 || max_height == 0 || quality < 1 || quality > 100)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct jpeg_encoder *enc = calloc(1, sizeof(*enc));
+    if (!enc)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    enc->max_width = max_width;
+    enc->max_height = max_height;
+    enc->strip_width = (max_width + MCU_SIZE - 1) & ~(size_t)(MCU_SIZE - 1);
+    enc->y_strip = malloc(enc->strip_width * MCU_SIZE);
+    enc->cb_strip = malloc(enc->strip_width * MCU_SIZE);
+    enc->cr_strip = malloc(enc->strip_width * MCU_SIZE);
+    if (!enc->y_strip || !enc->cb_strip || !enc->cr_strip)
+    {
+        jpeg_encoder_delete(enc);
+        return ESP_ERR_NO_MEM;
+    }
+
+    build_huff_table(&enc->dc_luma, dc_luma_bits, dc_luma_vals);
+    build_huff_table(&enc->ac_luma, ac_luma_bits, ac_luma_vals);
+    build_huff_table(&enc->dc_chroma, dc_chroma_bits, dc_chroma_vals);
+    build_huff_table(&enc->ac_chroma, ac_chroma_bits, ac_chroma_vals);
+    build_quant_tables(enc, quality);
+    enc->requested_quality = quality;
+
+    *out_encoder = enc;
+    return ESP_OK;
+}
+
+esp_err_t jpeg_encoder_set_quality(jpeg_encoder_handle_t encoder, int quality)
+{
+    if (!encoder || quality < 1 || quality > 100)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    encoder->requested_quality = quality;
+    return ESP_OK;
+}
+
+int jpeg_encoder_get_quality(jpeg_encoder_handle_t encoder)
+{
+    return encoder->requested_quality;
+}
+
+void jpeg_encoder_delete(jpeg_encoder_handle_t encoder)
+{
+    if (!encoder)
+    {
+        return;
+    }
+    free(encoder->y_strip);
+    free(encoder->cb_strip);
+    free(encoder->cr_strip);
+    free(encoder);
+}
+
+static inline void put_byte(bit_writer_t *bw, uint8_t byte)
+{
+    if (bw->pos < bw->capacity)
+    {
+        bw->out[bw->pos++] = byte;
+    }
+    else
+    {
+        bw->overflow = true;
+    }
+}
+
+static inline void put_word(bit_writer_t *bw, uint16_t word)
+{
+    put_byte(bw, word >> 8);
+    put_byte(bw, word & 0xff);
+}
+
+static inline void put_bits(bit_writer_t *bw, uint32_t code, int size)
+{
+    bw->bits = (bw->bits << size) | (code & ((1u << size) - 1));
+    bw->nbits += size;
+    while (bw->nbits >= 8)
+    {
+        uint8_t byte = bw->bits >> (bw->nbits - 8);
+        put_byte(bw, byte);
+        if (byte == 0xff)
+        {
+            put_byte(bw, 0);  // Byte stuffing
+        }
+        bw->nbits -= 8;
+    }
+    bw->bits &= (1u << bw->nbits) - 1;
+}
+
+static void flush_bits(bit_writer_t *bw)
+{
+    if (bw->nbits > 0)
+    {
+        put_bits(bw, 0x7f, 8 - bw->nbits);  // Pad with 1 bits
+    }
+}
+
+static void write_dht(bit_writer_t *bw, uint8_t class_id, const uint8_t bits[16],
+                      const uint8_t *vals, size_t nvals)
+{
+    put_byte(bw, class_id);
+    for (int i = 0; i < 16; i++)
+    {
+        put_byte(bw, bits[i]);
+    }
+    for (size_t i = 0; i < nvals; i++)
+    {
+        put_byte(bw, vals[i]);
+    }
+}
+
+static void write_headers(struct jpeg_encoder *enc, bit_writer_t *bw, uint16_t width, uint16_t height)
+{
+    static const uint8_t app0[] = {'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0};
+
+    put_word(bw, 0xffd8);  // SOI
+
+    put_word(bw, 0xffe0);  // APP0 (JFIF)
+    put_word(bw, 2 + sizeof(app0));
+    for (size_t i = 0; i < sizeof(app0); i++)
+    {
+        put_byte(bw, app0[i]);
+    }
+
+    put_word(bw, 0xffdb);  // DQT
+    put_word(bw, 2 + 2 * 65);
+    put_byte(bw, 0);
+    for (int i = 0; i < 64; i++)
+    {
+        put_byte(bw, enc->qt_luma[i]);
+    }
+    put_byte(bw, 1);
+    for (int i = 0; i < 64; i++)
+    {
+        put_byte(bw, enc->qt_chroma[i]);
+    }
+
+    put_word(bw, 0xffc0);  // SOF0
+    put_word(bw, 17);
+    put_byte(bw, 8);
+    put_word(bw, height);
+    put_word(bw, width);
+    put_byte(bw, 3);
+    put_byte(bw, 1);  // Y: 2x2 sampling, table 0
+    put_byte(bw, 0x22);
+    put_byte(bw, 0);
+    put_byte(bw, 2);  // Cb: 1x1 sampling, table 1
+    put_byte(bw, 0x11);
+    put_byte(bw, 1);
+    put_byte(bw, 3);  // Cr: 1x1 sampling, table 1
+    put_byte(bw, 0x11);
+    put_byte(bw, 1);
+
+    put_word(bw, 0xffc4);  // DHT
+    put_word(bw, 2 + 4 * 17 + sizeof(dc_luma_vals) + sizeof(ac_luma_vals) +
+                 sizeof(dc_chroma_vals) + sizeof(ac_chroma_vals));
+    write_dht(bw, 0x00, dc_luma_bits, dc_luma_vals, sizeof(dc_luma_vals));
+    write_dht(bw, 0x10, ac_luma_bits, ac_luma_vals, sizeof(ac_luma_vals));
+    write_dht(bw, 0x01, dc_chroma_bits, dc_chroma_vals, sizeof(dc_chroma_vals));
+    write_dht(bw, 0x11, ac_chroma_bits, ac_chroma_vals, sizeof(ac_chroma_vals));
+
+    put_word(bw, 0xffda);  // SOS
+    put_word(bw, 12);
+    put_byte(bw, 3);
+    put_byte(bw, 1);
+    put_byte(bw, 0x00);
+    put_byte(bw, 2);
+    put_byte(bw, 0x11);
+    put_byte(bw, 3);
+    put_byte(bw, 0x11);
+    put_byte(bw, 0);
+    put_byte(bw, 63);
+    put_byte(bw, 0);
+}
+
+// Convert up to 16 source rows into the Y/Cb/Cr strips, replicating the last
+// column and row into the padding. Fixed-point BT.601 full range; the 0.5
+// taps on b for Cb and r for Cr are 127/256 rather than 128/256, as in
+// libjpeg, so a saturated channel rounds to 255 instead of wrapping to 0.
+static void convert_strip(struct jpeg_encoder *enc, const uint8_t *rgb565,
+                          uint16_t width, uint16_t height, int mcu_row)
+{
+    const size_t sw = enc->strip_width;
+
+    for (int r = 0; r < MCU_SIZE; r++)
+    {
+        int sy = mcu_row * MCU_SIZE + r;
+        if (sy >= height)
+        {
+            sy = height - 1;
+        }
+        const uint8_t *src = rgb565 + (size_t)sy * width * 2;
+        uint8_t *y_row = enc->y_strip + r * sw;
+        uint8_t *cb_row = enc->cb_strip + r * sw;
+        uint8_t *cr_row = enc->cr_strip + r * sw;
+
+        for (int x = 0; x < width; x++)
+        {
+            uint32_t px = ((uint32_t)src[2 * x] << 8) | src[2 * x + 1];
+            int32_t r8 = ((px >> 8) & 0xf8) | (px >> 13);
+            int32_t g8 = ((px >> 3) & 0xfc) | ((px >> 9) & 0x03);
+            int32_t b8 = ((px << 3) & 0xf8) | ((px >> 2) & 0x07);
+
+            y_row[x] = (77 * r8 + 150 * g8 + 29 * b8 + 128) >> 8;
+            cb_row[x] = (-43 * r8 - 85 * g8 + 127 * b8 + (128 << 8) + 128) >> 8;
+            cr_row[x] = (127 * r8 - 107 * g8 - 21 * b8 + (128 << 8) + 128) >> 8;
+        }
+        for (size_t x = width; x < sw; x++)
+        {
+            y_row[x] = y_row[width - 1];
+            cb_row[x] = cb_row[width - 1];
+            cr_row[x] = cr_row[width - 1];
+        }
+    }
+
+    // 2x2 box filter for chroma, written into the top half of each strip
+    for (int r = 0; r < MCU_SIZE / 2; r++)
+    {
+        const uint8_t *cb0 = enc->cb_strip + 2 * r * sw;
+        const uint8_t *cr0 = enc->cr_strip + 2 * r * sw;
+        uint8_t *cb_out = enc->cb_strip + r * sw;
+        uint8_t *cr_out = enc->cr_strip + r * sw;
+
+        for (size_t x = 0; x < sw / 2; x++)
+        {
+            cb_out[x] = (cb0[2 * x] + cb0[2 * x + 1] + cb0[sw + 2 * x] + cb0[sw + 2 * x + 1] + 2) >> 2;
+            cr_out[x] = (cr0[2 * x] + cr0[2 * x + 1] + cr0[sw + 2 * x] + cr0[sw + 2 * x + 1] + 2) >> 2;
+        }
+    }
+}
+
+// Arai-Agui-Nakajima forward DCT; output is scaled as described by aan_scale
+static void fdct_8x8(float *d)
+{
+    for (int pass = 0; pass < 2; pass++)
+    {
+        const int step = pass == 0 ? 1 : 8;   // Along a row, then along a column
+        const int next = pass == 0 ? 8 : 1;
+
+        for (int i = 0; i < 8; i++)
+        {
+            float *p = d + i * next;
+            float tmp0 = p[0 * step] + p[7 * step];
+            float tmp7 = p[0 * step] - p[7 * step];
+            float tmp1 = p[1 * step] + p[6 * step];
+            float tmp6 = p[1 * step] - p[6 * step];
+            float tmp2 = p[2 * step] + p[5 * step];
+            float tmp5 = p[2 * step] - p[5 * step];
+            float tmp3 = p[3 * step] + p[4 * step];
+            float tmp4 = p[3 * step] - p[4 * step];
+
+            float tmp10 = tmp0 + tmp3;
+            float tmp13 = tmp0 - tmp3;
+            float tmp11 = tmp1 + tmp2;
+            float tmp12 = tmp1 - tmp2;
+
+            p[0 * step] = tmp10 + tmp11;
+            p[4 * step] = tmp10 - tmp11;
+
+            float z1 = (tmp12 + tmp13) * 0.707106781f;
+            p[2 * step] = tmp13 + z1;
+            p[6 * step] = tmp13 - z1;
+
+            tmp10 = tmp4 + tmp5;
+            tmp11 = tmp5 + tmp6;
+            tmp12 = tmp6 + tmp7;
+
+            float z5 = (tmp10 - tmp12) * 0.382683433f;
+            float z2 = 0.541196100f * tmp10 + z5;
+            float z4 = 1.306562965f * tmp12 + z5;
+            float z3 = tmp11 * 0.707106781f;
+            float z11 = tmp7 + z3;
+            float z13 = tmp7 - z3;
+
+            p[5 * step] = z13 + z2;
+            p[3 * step] = z13 - z2;
+            p[1 * step] = z11 + z4;
+            p[7 * step] = z11 - z4;
+        }
+    }
+}
+
+static inline int bit_length(int value)
+{
+    return value ? 32 - __builtin_clz((unsigned)value) : 0;
+}
+
+static void encode_block(bit_writer_t *bw, const uint8_t *src, size_t stride, const float *fdtbl,
+                         int *dc_prev, const huff_table_t *dc, const huff_table_t *ac)
+{
+    float block[64];
+    int coef[64];
+
+    for (int y = 0; y < 8; y++)
+    {
+        for (int x = 0; x < 8; x++)
+        {
+            block[y * 8 + x] = (float)src[y * stride + x] - 128.0f;
+        }
+    }
+
+    fdct_8x8(block);
+
+    for (int i = 0; i < 64; i++)
+    {
+        int n = zigzag_to_natural[i];
+        float v = block[n] * fdtbl[n];
+        coef[i] = (int)(v < 0.0f ? v - 0.5f : v + 0.5f);
+    }
+
+    int diff = coef[0] - *dc_prev;
+    *dc_prev = coef[0];
+    int magnitude = diff < 0 ? -diff : diff;
+    int cat = bit_length(magnitude);
+    put_bits(bw, dc->code[cat], dc->size[cat]);
+    if (cat)
+    {
+        put_bits(bw, diff < 0 ? diff - 1 : diff, cat);
+    }
+
+    int last = 63;
+    while (last > 0 && coef[last] == 0)
+    {
+        last--;
+    }
+
+    int run = 0;
+    for (int i = 1; i <= last; i++)
+    {
+        if (coef[i] == 0)
+        {
+            run++;
+            continue;
+        }
+        while (run >= 16)
+        {
+            put_bits(bw, ac->code[0xf0], ac->size[0xf0]);  // ZRL
+            run -= 16;
+        }
+        int v = coef[i];
+        magnitude = v < 0 ? -v : v;
+        cat = bit_length(magnitude);
+        int sym = (run << 4) | cat;
+        put_bits(bw, ac->code[sym], ac->size[sym]);
+        put_bits(bw, v < 0 ? v - 1 : v, cat);
+        run = 0;
+    }
+    if (last < 63)
+    {
+        put_bits(bw, ac->code[0x00], ac->size[0x00]);  // EOB
+    }
+}
+
+esp_err_t jpeg_encoder_encode(jpeg_encoder_handle_t encoder, const uint8_t *rgb565,
+                              uint16_t width, uint16_t height,
+                              uint8_t *out, size_t out_capacity, size_t *out_len)
+{
+    if (!encoder || !rgb565 || !out || !out_len || width == 0 || height == 0 ||
+        width > encoder->max_width || height > encoder->max_height)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int quality = encoder->requested_quality;
+    if (quality != encoder->quality)
+    {
+        build_quant_tables(encoder, quality);
+    }
+
+    bit_writer_t bw = {
+        .out = out,
+        .capacity = out_capacity,
+    };
+    write_headers(encoder, &bw, width, height);
+
+    const size_t sw = encoder->strip_width;
+    const int mcu_cols = (width + MCU_SIZE - 1) / MCU_SIZE;
+    const int mcu_rows = (height + MCU_SIZE - 1) / MCU_SIZE;
+    int dc_y = 0, dc_cb = 0, dc_cr = 0;
+
+    for (int my = 0; my < mcu_rows && !bw.overflow; my++)
+    {
+        convert_strip(encoder, rgb565, width, height, my);
+
+        for (int mx = 0; mx < mcu_cols; mx++)
+        {
+            const uint8_t *y = encoder->y_strip + mx * MCU_SIZE;
+            encode_block(&bw, y, sw, encoder->fdtbl_luma, &dc_y, &encoder->dc_luma, &encoder->ac_luma);
+            encode_block(&bw, y + 8, sw, encoder->fdtbl_luma, &dc_y, &encoder->dc_luma, &encoder->ac_luma);
+            encode_block(&bw, y + 8 * sw, sw, encoder->fdtbl_luma, &dc_y, &encoder->dc_luma, &encoder->ac_luma);
+            encode_block(&bw, y + 8 * sw + 8, sw, encoder->fdtbl_luma, &dc_y, &encoder->dc_luma, &encoder->ac_luma);
+            encode_block(&bw, encoder->cb_strip + mx * 8, sw, encoder->fdtbl_chroma, &dc_cb,
+                         &encoder->dc_chroma, &encoder->ac_chroma);
+            encode_block(&bw, encoder->cr_strip + mx * 8, sw, encoder->fdtbl_chroma, &dc_cr,
+                         &encoder->dc_chroma, &encoder->ac_chroma);
+        }
+    }
+
+    flush_bits(&bw);
+    put_word(&bw, 0xffd9);  // EOI
+
+    if (bw.overflow)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    *out_len = bw.pos;
+    return ESP_OK;
+}
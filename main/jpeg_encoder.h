@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Baseline JPEG encoder for RGB565 frames (4:2:0 chroma subsampling, standard
+// Huffman tables). All working memory is allocated by jpeg_encoder_create, so
+// encoding a frame never touches the heap.
+
+typedef struct jpeg_encoder *jpeg_encoder_handle_t;
+
+// Create an encoder for frames up to max_width x max_height. quality is 1..100.
+esp_err_t jpeg_encoder_create(uint16_t max_width, uint16_t max_height, int quality,
+                              jpeg_encoder_handle_t *out_encoder);
+
+// Change the quality used by the next encode (1..100)
+esp_err_t jpeg_encoder_set_quality(jpeg_encoder_handle_t encoder, int quality);
+
+int jpeg_encoder_get_quality(jpeg_encoder_handle_t encoder);
+
+// Encode a big-endian RGB565 image (the esp32-camera byte order) into out.
+// Returns ESP_ERR_INVALID_SIZE if the result does not fit in out_capacity.
+esp_err_t jpeg_encoder_encode(jpeg_encoder_handle_t encoder, const uint8_t *rgb565,
+                              uint16_t width, uint16_t height,
+                              uint8_t *out, size_t out_capacity, size_t *out_len);
+
+void jpeg_encoder_delete(jpeg_encoder_handle_t encoder);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,197 @@
+#include "live_view.h"
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <sys/socket.h>
+#include <esp_log.h>
+#include <esp_http_server.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+static const char *TAG = "live_view";
+
+#define BOUNDARY         "esp32s3eyeframe"
+#define STREAM_TYPE      "multipart/x-mixed-replace;boundary=" BOUNDARY
+#define PART_HEADER      "--" BOUNDARY "\r\nContent-Type: image/jpeg\r\nContent-Length: %" PRIu32 \
+                         "\r\nX-Frame-Seq: %" PRIu32 "\r\n\r\n"
+#define WAIT_POLL_MS     1000
+#define STREAM_STACK     4096
+
+static const char index_page[] =
+    "<!DOCTYPE html><html><head><title>Live view</title></head>"
+    "<body style=\"margin:0;background:#000\">"
+    "<img src=\"/stream\" style=\"display:block;margin:auto;max-width:100%;height:auto\">"
+    "</body></html>";
+
+struct live_view {
+    live_view_config_t config;
+    httpd_handle_t server;
+    frame_fanout_handle_t fanout;
+    atomic_uint_least32_t clients;
+    atomic_uint_least32_t rejected;
+};
+
+typedef struct {
+    struct live_view *lv;
+    httpd_req_t *req;          // Async copy owned by the stream task
+} stream_client_t;
+
+// A viewer that went away is only noticed when a send fails, and nothing is
+// sent while no frames arrive (a static scene, or capture stopped). Peek at the
+// socket instead: a closed or reset connection reads as such at once, while a
+// live one has nothing to read.
+static bool viewer_connected(httpd_req_t *req)
+{
+    char c;
+    int n = recv(httpd_req_to_sockfd(req), &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+}
+
+// Sends frames to one viewer until its connection fails or closes
+static void stream_task(void *pvParameters)
+{
+    stream_client_t *client = pvParameters;
+    struct live_view *lv = client->lv;
+    httpd_req_t *req = client->req;
+    frame_fanout_reader_t reader = {0};
+    char part[160];
+
+    httpd_resp_set_type(req, STREAM_TYPE);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    esp_err_t err = ESP_OK;
+    while (err == ESP_OK)
+    {
+        const pipeline_frame_t *frame = frame_fanout_acquire(lv->fanout, &reader, WAIT_POLL_MS);
+        if (!frame)
+        {
+            if (!viewer_connected(req))
+            {
+                break;
+            }
+            continue;
+        }
+        if (frame->format == FRAME_FORMAT_JPEG)
+        {
+            int n = snprintf(part, sizeof(part), PART_HEADER, (uint32_t)frame->len, frame->seq);
+            err = httpd_resp_send_chunk(req, part, n);
+            if (err == ESP_OK)
+            {
+                // Straight from the shared slot, no per-viewer copy
+                err = httpd_resp_send_chunk(req, (const char *)frame->buf, frame->len);
+            }
+            if (err == ESP_OK)
+            {
+                err = httpd_resp_send_chunk(req, "\r\n", 2);
+            }
+        }
+        frame_fanout_release(lv->fanout, frame);
+    }
+
+    ESP_LOGI(TAG, "Viewer left after %" PRIu32 " frames, %" PRIu32 " skipped", reader.frames, reader.skipped);
+    httpd_req_async_handler_complete(req);
+    atomic_fetch_sub_explicit(&lv->clients, 1, memory_order_relaxed);
+    free(client);
+    vTaskDelete(NULL);
+}
+
+static esp_err_t stream_handler(httpd_req_t *req)
+{
+    struct live_view *lv = req->user_ctx;
+
+    if (atomic_fetch_add_explicit(&lv->clients, 1, memory_order_relaxed) >= lv->config.max_clients)
+    {
+        atomic_fetch_sub_explicit(&lv->clients, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&lv->rejected, 1, memory_order_relaxed);
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        return httpd_resp_send(req, "Too many viewers\n", HTTPD_RESP_USE_STRLEN);
+    }
+
+    // Hand the request to a task of its own so the server keeps serving others
+    stream_client_t *client = malloc(sizeof(*client));
+    httpd_req_t *copy = NULL;
+    if (!client || httpd_req_async_handler_begin(req, &copy) != ESP_OK)
+    {
+        free(client);
+        atomic_fetch_sub_explicit(&lv->clients, 1, memory_order_relaxed);
+        return ESP_FAIL;
+    }
+    client->lv = lv;
+    client->req = copy;
+    if (xTaskCreate(stream_task, "live_view", STREAM_STACK, client, lv->config.task_priority, NULL) != pdPASS)
+    {
+        httpd_req_async_handler_complete(copy);
+        free(client);
+        atomic_fetch_sub_explicit(&lv->clients, 1, memory_order_relaxed);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t index_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "text/html");
+    return httpd_resp_send(req, index_page, sizeof(index_page) - 1);
+}
+
+esp_err_t live_view_start(const live_view_config_t *config, frame_fanout_handle_t fanout,
+                          live_view_handle_t *out_live_view)
+{
+    if (!config || !fanout || !out_live_view || config->max_clients == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct live_view *lv = calloc(1, sizeof(*lv));
+    if (!lv)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    lv->config = *config;
+    lv->fanout = fanout;
+
+    httpd_config_t server_config = HTTPD_DEFAULT_CONFIG();
+    server_config.server_port = config->port;
+    // Every viewer keeps a socket open; leave room for page loads next to them
+    server_config.max_open_sockets = config->max_clients + 2;
+    esp_err_t err = httpd_start(&lv->server, &server_config);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to start HTTP server: %s", esp_err_to_name(err));
+        free(lv);
+        return err;
+    }
+
+    const httpd_uri_t uris[] = {
+        { .uri = "/", .method = HTTP_GET, .handler = index_handler, .user_ctx = lv },
+        { .uri = "/stream", .method = HTTP_GET, .handler = stream_handler, .user_ctx = lv },
+    };
+    for (size_t i = 0; i < sizeof(uris) / sizeof(uris[0]); i++)
+    {
+        httpd_register_uri_handler(lv->server, &uris[i]);
+    }
+
+    ESP_LOGI(TAG, "Serving live view on port %u for up to %zu viewers", config->port, config->max_clients);
+    *out_live_view = lv;
+    return ESP_OK;
+}
+
+uint32_t live_view_client_count(live_view_handle_t live_view)
+{
+    return atomic_load_explicit(&live_view->clients, memory_order_relaxed);
+}
+
+void live_view_get_stats(live_view_handle_t live_view, live_view_stats_t *out_stats)
+{
+    frame_fanout_stats_t fs;
+
+    frame_fanout_get_stats(live_view->fanout, &fs);
+    out_stats->clients = atomic_load_explicit(&live_view->clients, memory_order_relaxed);
+    out_stats->rejected = atomic_load_explicit(&live_view->rejected, memory_order_relaxed);
+    out_stats->frames_sent = fs.delivered;
+    out_stats->frames_skipped = fs.skipped;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include "frame_fanout.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Local MJPEG live view. GET / serves a page showing the stream and GET /stream
+// a multipart/x-mixed-replace stream of the JPEG frames published to a
+// frame_fanout. Every viewer runs on its own task and sends straight from the
+// shared pipeline slot; a viewer whose socket is slow gets the newest frame
+// once it is ready again and skips the ones in between.
+
+typedef struct {
+    uint16_t port;
+    size_t max_clients;        // Streams served at once; the pipeline needs tap_slots = 1 + max_clients
+    unsigned task_priority;    // Priority of the per-viewer tasks
+} live_view_config_t;
+
+typedef struct {
+    uint32_t clients;          // Streams open right now
+    uint32_t rejected;         // Streams refused because max_clients were open
+    uint32_t frames_sent;      // Frames handed to viewers, summed over viewers
+    uint32_t frames_skipped;   // Frames viewers were too slow for
+} live_view_stats_t;
+
+typedef struct live_view *live_view_handle_t;
+
+esp_err_t live_view_start(const live_view_config_t *config, frame_fanout_handle_t fanout,
+                          live_view_handle_t *out_live_view);
+
+void live_view_get_stats(live_view_handle_t live_view, live_view_stats_t *out_stats);
+
+// Streams open right now; cheap enough to ask for every frame
+uint32_t live_view_client_count(live_view_handle_t live_view);
+
+#ifdef __cplusplus
+}
+#endif
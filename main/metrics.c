@@ -0,0 +1,274 @@
+#include "metrics.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <string.h>
+#include <esp_log.h>
+#include <esp_bit_defs.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/event_groups.h>
+
+static const char *TAG = "metrics";
+
+// Snapshots are built on a task of their own: cJSON, the application hook
+// and the log call are too heavy for the esp_timer task, which every timer
+// callback in the system shares
+#define REPORT_TASK_STACK    4096
+#define REPORT_TASK_PRIORITY 1
+#define REPORT_TASK_EXITED   BIT0
+
+typedef struct {
+    atomic_uint_least32_t errors;
+    atomic_uint_least32_t max_us;
+    // 64 bits, so it does not wrap after 71 minutes of samples. Not lock-free
+    // on Xtensa, where the toolchain's 64-bit atomics take a short critical
+    // section, but always read whole: a pair of 32-bit words can be read
+    // between the low word wrapping and the high word catching up.
+    atomic_uint_least64_t total_us;
+    atomic_uint_least32_t buckets[METRICS_HISTOGRAM_BUCKETS];
+} stage_metrics_t;
+
+static stage_metrics_t s_stages[METRIC_COUNT];
+static EventGroupHandle_t s_report_events;   // Non-NULL while reporting runs
+static volatile bool s_report_stop;
+static uint32_t s_report_period_ms;
+static metrics_report_hook_t s_report_hook;
+static void *s_report_ctx;
+
+static const char *const s_stage_names[METRIC_COUNT] = {
+    [METRIC_INIT_CAMERA] = "init_camera",
+    [METRIC_FB_GET] = "fb_get",
+    [METRIC_ENCODE] = "encode",
+    [METRIC_DNS] = "dns",
+    [METRIC_CONNECT] = "connect",
+    [METRIC_SEND] = "send",
+    [METRIC_RESPONSE] = "response",
+    [METRIC_FRAME] = "frame",
+};
+
+const char *metrics_stage_name(metric_stage_t stage)
+{
+    return stage < METRIC_COUNT ? s_stage_names[stage] : "unknown";
+}
+
+static inline int bucket_of(uint32_t us)
+{
+    int b = us == 0 ? 0 : 32 - __builtin_clz(us);
+    return b < METRICS_HISTOGRAM_BUCKETS ? b : METRICS_HISTOGRAM_BUCKETS - 1;
+}
+
+void metrics_record(metric_stage_t stage, int64_t duration_us)
+{
+    if (stage >= METRIC_COUNT)
+    {
+        return;
+    }
+    stage_metrics_t *m = &s_stages[stage];
+    uint32_t us = duration_us < 0 ? 0 : duration_us > UINT32_MAX ? UINT32_MAX : (uint32_t)duration_us;
+
+    atomic_fetch_add_explicit(&m->buckets[bucket_of(us)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&m->total_us, us, memory_order_relaxed);
+
+    uint32_t max = atomic_load_explicit(&m->max_us, memory_order_relaxed);
+    while (us > max &&
+           !atomic_compare_exchange_weak_explicit(&m->max_us, &max, us, memory_order_relaxed,
+                                                  memory_order_relaxed))
+    {
+    }
+}
+
+void metrics_record_error(metric_stage_t stage)
+{
+    if (stage < METRIC_COUNT)
+    {
+        atomic_fetch_add_explicit(&s_stages[stage].errors, 1, memory_order_relaxed);
+    }
+}
+
+// Value below which the given share of samples fall, interpolated linearly
+// inside the histogram bucket it lands in
+static uint32_t percentile(const uint32_t *histogram, uint32_t count, uint32_t max_us, uint32_t permille)
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    uint64_t rank = ((uint64_t)count * permille + 999) / 1000;
+    uint64_t seen = 0;
+
+    for (int b = 0; b < METRICS_HISTOGRAM_BUCKETS; b++)
+    {
+        if (seen + histogram[b] >= rank)
+        {
+            if (b == 0)
+            {
+                return 0;
+            }
+            // The bucket's upper edge is clipped to the largest sample seen
+            uint64_t lo = 1ull << (b - 1);
+            uint64_t hi = (uint64_t)max_us + 1;
+            if (b < METRICS_HISTOGRAM_BUCKETS - 1 && hi > 1ull << b)
+            {
+                hi = 1ull << b;
+            }
+            uint64_t v = lo + (hi - lo) * (rank - seen) / histogram[b];
+            return v < max_us ? v : max_us;
+        }
+        seen += histogram[b];
+    }
+    return max_us;
+}
+
+void metrics_get_summary(metric_stage_t stage, metrics_summary_t *out_summary)
+{
+    memset(out_summary, 0, sizeof(*out_summary));
+    if (stage >= METRIC_COUNT)
+    {
+        return;
+    }
+    stage_metrics_t *m = &s_stages[stage];
+
+    for (int b = 0; b < METRICS_HISTOGRAM_BUCKETS; b++)
+    {
+        out_summary->histogram[b] = atomic_load_explicit(&m->buckets[b], memory_order_relaxed);
+        out_summary->count += out_summary->histogram[b];
+    }
+    out_summary->errors = atomic_load_explicit(&m->errors, memory_order_relaxed);
+    out_summary->total_us = atomic_load_explicit(&m->total_us, memory_order_relaxed);
+    out_summary->max_us = atomic_load_explicit(&m->max_us, memory_order_relaxed);
+    out_summary->p50_us = percentile(out_summary->histogram, out_summary->count, out_summary->max_us, 500);
+    out_summary->p90_us = percentile(out_summary->histogram, out_summary->count, out_summary->max_us, 900);
+    out_summary->p99_us = percentile(out_summary->histogram, out_summary->count, out_summary->max_us, 990);
+}
+
+void metrics_reset(void)
+{
+    for (int i = 0; i < METRIC_COUNT; i++)
+    {
+        stage_metrics_t *m = &s_stages[i];
+        atomic_store_explicit(&m->errors, 0, memory_order_relaxed);
+        atomic_store_explicit(&m->max_us, 0, memory_order_relaxed);
+        atomic_store_explicit(&m->total_us, 0, memory_order_relaxed);
+        for (int b = 0; b < METRICS_HISTOGRAM_BUCKETS; b++)
+        {
+            atomic_store_explicit(&m->buckets[b], 0, memory_order_relaxed);
+        }
+    }
+}
+
+cJSON *metrics_to_json(void)
+{
+    cJSON *root = cJSON_CreateObject();
+    cJSON *stages = cJSON_AddObjectToObject(root, "stages");
+    if (!stages)
+    {
+        cJSON_Delete(root);
+        return NULL;
+    }
+    cJSON_AddNumberToObject(root, "uptime_ms", (double)(esp_timer_get_time() / 1000));
+
+    for (int i = 0; i < METRIC_COUNT; i++)
+    {
+        metrics_summary_t s;
+        metrics_get_summary(i, &s);
+        if (s.count == 0 && s.errors == 0)
+        {
+            continue;
+        }
+
+        cJSON *stage = cJSON_AddObjectToObject(stages, s_stage_names[i]);
+        if (!stage)
+        {
+            continue;
+        }
+        cJSON_AddNumberToObject(stage, "n", s.count);
+        cJSON_AddNumberToObject(stage, "err", s.errors);
+        cJSON_AddNumberToObject(stage, "mean_us", s.count ? (double)(s.total_us / s.count) : 0);
+        cJSON_AddNumberToObject(stage, "p50_us", s.p50_us);
+        cJSON_AddNumberToObject(stage, "p90_us", s.p90_us);
+        cJSON_AddNumberToObject(stage, "p99_us", s.p99_us);
+        cJSON_AddNumberToObject(stage, "max_us", s.max_us);
+    }
+    return root;
+}
+
+static void report_snapshot(void)
+{
+    cJSON *snapshot = metrics_to_json();
+    if (!snapshot)
+    {
+        return;
+    }
+    if (s_report_hook)
+    {
+        s_report_hook(snapshot, s_report_ctx);
+    }
+
+    char *json = cJSON_PrintUnformatted(snapshot);
+    if (json)
+    {
+        ESP_LOGI(TAG, "%s", json);
+        cJSON_free(json);
+    }
+    cJSON_Delete(snapshot);
+}
+
+static void report_task(void *arg)
+{
+    TickType_t last_wake = xTaskGetTickCount();
+
+    while (true)
+    {
+        // Fixed rate: the time spent on a snapshot does not delay the next one
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(s_report_period_ms));
+        if (s_report_stop)
+        {
+            break;
+        }
+        report_snapshot();
+    }
+
+    xEventGroupSetBits(s_report_events, REPORT_TASK_EXITED);
+    vTaskDelete(NULL);
+}
+
+esp_err_t metrics_start_reporting(uint32_t period_ms, metrics_report_hook_t hook, void *ctx)
+{
+    if (period_ms == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_report_events)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    s_report_events = xEventGroupCreate();
+    if (!s_report_events)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    s_report_stop = false;
+    s_report_period_ms = period_ms;
+    s_report_hook = hook;
+    s_report_ctx = ctx;
+    if (xTaskCreate(report_task, "metrics", REPORT_TASK_STACK, NULL, REPORT_TASK_PRIORITY, NULL) != pdPASS)
+    {
+        vEventGroupDelete(s_report_events);
+        s_report_events = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void metrics_stop_reporting(void)
+{
+    if (s_report_events)
+    {
+        s_report_stop = true;
+        xEventGroupWaitBits(s_report_events, REPORT_TASK_EXITED, pdFALSE, pdTRUE, portMAX_DELAY);
+        vEventGroupDelete(s_report_events);
+        s_report_events = NULL;
+    }
+}
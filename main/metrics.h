@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+#include <esp_err.h>
+#include <esp_timer.h>
+#include "cJSON.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Per-stage latency instrumentation. Every stage has a sample counter, an
+// error counter and a log2 latency histogram, all updated with relaxed
+// atomics, so metrics_record() can be called from any task on either core
+// without taking a lock; only the 64-bit latency total falls back to a brief
+// critical section on Xtensa. Percentiles are estimated from the histogram.
+
+typedef enum {
+    METRIC_INIT_CAMERA,     // esp_camera_init()
+    METRIC_FB_GET,          // Waiting for a frame from the camera driver
+    METRIC_ENCODE,          // Payload encoding
+    METRIC_DNS,             // Host name lookup
+    METRIC_CONNECT,         // TCP connect and TLS handshake together: esp_tls_conn_new_sync()
+                            // does both in one call and does not report when the TCP phase ends
+    METRIC_SEND,            // Request head and body on the wire
+    METRIC_RESPONSE,        // Waiting for and reading the response
+    METRIC_FRAME,           // Capture to completed upload
+    METRIC_COUNT,
+} metric_stage_t;
+
+// Bucket 0 counts 0 us, bucket i counts [2^(i-1), 2^i) us; the last one is open-ended
+#define METRICS_HISTOGRAM_BUCKETS 32
+
+typedef struct {
+    uint32_t count;
+    uint32_t errors;
+    uint64_t total_us;
+    uint32_t max_us;
+    uint32_t p50_us;
+    uint32_t p90_us;
+    uint32_t p99_us;
+    uint32_t histogram[METRICS_HISTOGRAM_BUCKETS];
+} metrics_summary_t;
+
+void metrics_record(metric_stage_t stage, int64_t duration_us);
+
+void metrics_record_error(metric_stage_t stage);
+
+// Convenience for timing a stage: start = metrics_now(); ...; metrics_since(stage, start)
+static inline int64_t metrics_now(void)
+{
+    return esp_timer_get_time();
+}
+
+static inline void metrics_since(metric_stage_t stage, int64_t start_us)
+{
+    metrics_record(stage, esp_timer_get_time() - start_us);
+}
+
+const char *metrics_stage_name(metric_stage_t stage);
+
+void metrics_get_summary(metric_stage_t stage, metrics_summary_t *out_summary);
+
+void metrics_reset(void);
+
+// Snapshot of all stages that have samples, as a cJSON object the caller deletes
+cJSON *metrics_to_json(void);
+
+// Called with each periodic snapshot so the application can add its own fields.
+// Runs on the reporting task, so it may take locks and block briefly.
+typedef void (*metrics_report_hook_t)(cJSON *snapshot, void *ctx);
+
+// Log a compact JSON snapshot every period_ms from a low-priority task
+esp_err_t metrics_start_reporting(uint32_t period_ms, metrics_report_hook_t hook, void *ctx);
+
+// Stop reporting and wait for the task to exit, which takes up to one period
+void metrics_stop_reporting(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,312 @@
+#include "q565.h"
+
+#include <string.h>
+
+#define OP_INDEX 0x00
+#define OP_DIFF  0x40
+#define OP_LUMA  0x80
+#define OP_RUN   0xc0
+#define OP_RAW   0xff
+#define OP_MASK  0xc0
+
+#define MAX_RUN     63      // Run lengths 1..63 use 0xc0..0xfe, 0xff is RAW
+#define INDEX_SIZE  64
+
+static const uint8_t magic[4] = {'q', '5', '6', '5'};
+
+static inline uint16_t load_pixel(const uint8_t *p)
+{
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static inline void store_pixel(uint8_t *p, uint16_t px)
+{
+    p[0] = px >> 8;
+    p[1] = px & 0xff;
+}
+
+static inline unsigned hash_pixel(uint16_t px)
+{
+    return (px * 0x9e3779b1u) >> 26;
+}
+
+// Median edge detector: the smaller or larger neighbour across an edge,
+// otherwise the planar gradient a + b - c
+static inline int med(int a, int b, int c)
+{
+    int hi = a > b ? a : b;
+    int lo = a < b ? a : b;
+
+    if (c >= hi)
+    {
+        return lo;
+    }
+    if (c <= lo)
+    {
+        return hi;
+    }
+    return a + b - c;
+}
+
+// above is the previous row, NULL on the first row; prev is the left pixel
+// (or the last pixel of the previous row at x == 0)
+static inline uint16_t predict(const uint8_t *above, uint16_t x, uint16_t prev)
+{
+    if (!above)
+    {
+        return prev;
+    }
+    uint16_t b = load_pixel(above + 2 * x);
+    if (x == 0)
+    {
+        return b;
+    }
+    uint16_t a = prev;
+    uint16_t c = load_pixel(above + 2 * x - 2);
+
+    int r = med(a >> 11, b >> 11, c >> 11);
+    int g = med((a >> 5) & 63, (b >> 5) & 63, (c >> 5) & 63);
+    int bl = med(a & 31, b & 31, c & 31);
+    return (uint16_t)(r << 11 | g << 5 | bl);
+}
+
+// Residuals wrap around the channel width, so every value is reachable
+static inline int wrap5(int v)
+{
+    return ((v + 16) & 31) - 16;
+}
+
+static inline int wrap6(int v)
+{
+    return ((v + 32) & 63) - 32;
+}
+
+esp_err_t q565_encode(const uint8_t *rgb565, uint16_t width, uint16_t height,
+                      uint8_t *out, size_t out_capacity, size_t *out_len)
+{
+    if (!rgb565 || !out || !out_len || width == 0 || height == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (out_capacity < Q565_HEADER_SIZE)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    memcpy(out, magic, sizeof(magic));
+    out[4] = width & 0xff;
+    out[5] = width >> 8;
+    out[6] = height & 0xff;
+    out[7] = height >> 8;
+
+    uint16_t index[INDEX_SIZE] = {0};
+    uint16_t prev = 0;
+    unsigned run = 0;
+    size_t pos = Q565_HEADER_SIZE;
+
+    for (uint16_t y = 0; y < height; y++)
+    {
+        const uint8_t *row = rgb565 + (size_t)y * width * 2;
+        const uint8_t *above = y > 0 ? row - (size_t)width * 2 : NULL;
+
+        for (uint16_t x = 0; x < width; x++)
+        {
+            uint16_t px = load_pixel(row + 2 * x);
+
+            if (px == prev)
+            {
+                if (++run == MAX_RUN)
+                {
+                    if (pos >= out_capacity)
+                    {
+                        return ESP_ERR_INVALID_SIZE;
+                    }
+                    out[pos++] = OP_RUN | (run - 1);
+                    run = 0;
+                }
+                continue;
+            }
+            // A pending run byte plus the largest op
+            if (pos + (run > 0) + 3 > out_capacity)
+            {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            if (run > 0)
+            {
+                out[pos++] = OP_RUN | (run - 1);
+                run = 0;
+            }
+
+            unsigned slot = hash_pixel(px);
+            if (index[slot] == px)
+            {
+                out[pos++] = OP_INDEX | slot;
+                prev = px;
+                continue;
+            }
+            index[slot] = px;
+
+            uint16_t pred = predict(above, x, prev);
+            int dr = wrap5((px >> 11) - (pred >> 11));
+            int dg = wrap6(((px >> 5) & 63) - ((pred >> 5) & 63));
+            int db = wrap5((px & 31) - (pred & 31));
+
+            if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+            {
+                out[pos++] = OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2);
+            }
+            else
+            {
+                int vr = wrap5(dr - dg / 2);
+                int vb = wrap5(db - dg / 2);
+                if (vr >= -8 && vr <= 7 && vb >= -8 && vb <= 7)
+                {
+                    out[pos++] = OP_LUMA | (dg + 32);
+                    out[pos++] = (vr + 8) << 4 | (vb + 8);
+                }
+                else
+                {
+                    out[pos++] = OP_RAW;
+                    out[pos++] = px >> 8;
+                    out[pos++] = px & 0xff;
+                }
+            }
+            prev = px;
+        }
+    }
+    if (run > 0)
+    {
+        if (pos >= out_capacity)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        out[pos++] = OP_RUN | (run - 1);
+    }
+
+    *out_len = pos;
+    return ESP_OK;
+}
+
+esp_err_t q565_read_header(const uint8_t *in, size_t len, uint16_t *out_width, uint16_t *out_height)
+{
+    if (!in || len < Q565_HEADER_SIZE || memcmp(in, magic, sizeof(magic)) != 0)
+    {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    uint16_t width = in[4] | in[5] << 8;
+    uint16_t height = in[6] | in[7] << 8;
+    if (width == 0 || height == 0)
+    {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    *out_width = width;
+    *out_height = height;
+    return ESP_OK;
+}
+
+esp_err_t q565_decode(const uint8_t *in, size_t len, uint8_t *out, size_t out_capacity,
+                      uint16_t *out_width, uint16_t *out_height)
+{
+    uint16_t width, height;
+
+    if (!out || !out_width || !out_height)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = q565_read_header(in, len, &width, &height);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    if ((size_t)width * height * 2 > out_capacity)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint16_t index[INDEX_SIZE] = {0};
+    uint16_t prev = 0;
+    unsigned run = 0;
+    size_t pos = Q565_HEADER_SIZE;
+
+    for (uint16_t y = 0; y < height; y++)
+    {
+        uint8_t *row = out + (size_t)y * width * 2;
+        const uint8_t *above = y > 0 ? row - (size_t)width * 2 : NULL;
+
+        for (uint16_t x = 0; x < width; x++)
+        {
+            if (run > 0)
+            {
+                run--;
+                store_pixel(row + 2 * x, prev);
+                continue;
+            }
+            if (pos >= len)
+            {
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+
+            uint8_t op = in[pos++];
+            uint16_t px;
+            if (op == OP_RAW)
+            {
+                if (len - pos < 2)
+                {
+                    return ESP_ERR_INVALID_RESPONSE;
+                }
+                px = (uint16_t)(in[pos] << 8 | in[pos + 1]);
+                pos += 2;
+            }
+            else if ((op & OP_MASK) == OP_RUN)
+            {
+                run = op & 0x3f;  // This pixel plus run more
+                store_pixel(row + 2 * x, prev);
+                continue;
+            }
+            else if ((op & OP_MASK) == OP_INDEX)
+            {
+                prev = index[op];
+                store_pixel(row + 2 * x, prev);
+                continue;
+            }
+            else
+            {
+                int dr, dg, db;
+                if ((op & OP_MASK) == OP_DIFF)
+                {
+                    dr = (op >> 4 & 3) - 2;
+                    dg = (op >> 2 & 3) - 2;
+                    db = (op & 3) - 2;
+                }
+                else
+                {
+                    if (pos >= len)
+                    {
+                        return ESP_ERR_INVALID_RESPONSE;
+                    }
+                    uint8_t rb = in[pos++];
+                    dg = (op & 0x3f) - 32;
+                    dr = (rb >> 4) - 8 + dg / 2;
+                    db = (rb & 15) - 8 + dg / 2;
+                }
+                uint16_t pred = predict(above, x, prev);
+                int r = ((pred >> 11) + dr) & 31;
+                int g = (((pred >> 5) & 63) + dg) & 63;
+                int b = ((pred & 31) + db) & 31;
+                px = (uint16_t)(r << 11 | g << 5 | b);
+            }
+
+            index[hash_pixel(px)] = px;
+            prev = px;
+            store_pixel(row + 2 * x, px);
+        }
+    }
+    if (run > 0 || pos != len)
+    {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    *out_width = width;
+    *out_height = height;
+    return ESP_OK;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Lossless codec for RGB565 frames in the spirit of QOI. Encoding is a single
+// pass over the image; the only state is the previous pixel, the current run
+// length and a 64-entry table of recently seen pixels (128 bytes on the stack).
+//
+// Stream layout: an 8-byte header (magic "q565", width and height as
+// little-endian uint16) followed by one op per pixel or run of pixels:
+//
+//   00iiiiii                 INDEX  pixel from slot i of the recent-pixel table
+//   01rrggbb                 DIFF   per-channel residuals -2..1 from the prediction
+//   10gggggg rrrrbbbb        LUMA   green residual -32..31, red and blue residuals
+//                                   -8..7 relative to half the green residual
+//   11nnnnnn                 RUN    previous pixel repeated n + 1 times (n < 63)
+//   11111111 hhhhhhhh llllllll  RAW pixel, big-endian
+//
+// The prediction is the left pixel on the first row, the pixel above in the
+// first column and otherwise the LOCO-I median edge detector of the left,
+// above and upper-left pixels, per channel. Residuals wrap around the channel
+// width. The upper rows are read back from the image itself, so no line
+// buffer is needed. tools/q565.py decodes the format on a host.
+
+#define Q565_HEADER_SIZE 8
+
+// Largest possible encoding of a width x height image
+#define Q565_MAX_SIZE(width, height) (Q565_HEADER_SIZE + (size_t)(width) * (height) * 3)
+
+// Encode a big-endian RGB565 image (the esp32-camera byte order) into out.
+// Returns ESP_ERR_INVALID_SIZE if the result does not fit in out_capacity.
+esp_err_t q565_encode(const uint8_t *rgb565, uint16_t width, uint16_t height,
+                      uint8_t *out, size_t out_capacity, size_t *out_len);
+
+// Read the image size from an encoded stream
+esp_err_t q565_read_header(const uint8_t *in, size_t len, uint16_t *out_width, uint16_t *out_height);
+
+// Decode a stream into big-endian RGB565. Returns ESP_ERR_INVALID_SIZE if the
+// image does not fit in out_capacity and ESP_ERR_INVALID_RESPONSE if the
+// stream is malformed.
+esp_err_t q565_decode(const uint8_t *in, size_t len, uint8_t *out, size_t out_capacity,
+                      uint16_t *out_width, uint16_t *out_height);
+
+#ifdef __cplusplus
+}
+#endif
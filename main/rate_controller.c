@@ -0,0 +1,158 @@
+#include "rate_controller.h"
+
+#include <stdlib.h>
+
+#define HOLD_PERIODS 1      // Periods after a change in which only severe congestion acts
+#define MAX_BACKOFF  16     // Cap on the multiplier of up_periods after failed probes
+#define FIT_PCT      75     // Most of the measured throughput a level stepped to may need
+
+struct rate_controller {
+    rate_controller_config_t config;
+    size_t level;
+    uint32_t good_periods;  // Periods of headroom in a row at this level
+    uint32_t hold;          // Periods left before the next ordinary decision
+    uint32_t backoff;       // up_periods multiplier, doubled by each failed probe
+    bool probing;           // Stepped up and not yet confirmed
+    uint32_t throughput;    // Bytes per second, smoothed
+};
+
+esp_err_t rate_controller_create(const rate_controller_config_t *config, rate_controller_handle_t *out_controller)
+{
+    if (!config || !out_controller || config->num_levels == 0 || config->initial_level >= config->num_levels ||
+        config->target_latency_ms == 0 || config->up_periods == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct rate_controller *c = calloc(1, sizeof(*c));
+    if (!c)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    c->config = *config;
+    c->level = config->initial_level;
+    c->backoff = 1;
+    *out_controller = c;
+    return ESP_OK;
+}
+
+// Whether a level needs at most pct percent of a throughput of bps
+static bool fits(const struct rate_controller *c, size_t level, uint32_t bps, uint32_t pct)
+{
+    if (!c->config.level_bps || bps == 0)
+    {
+        return true;  // Nothing to compare against yet
+    }
+    return (uint64_t)c->config.level_bps[level] * 100 <= (uint64_t)bps * pct;
+}
+
+static void set_level(struct rate_controller *c, size_t level)
+{
+    c->probing = level > c->level;
+    c->level = level;
+    c->good_periods = 0;
+    c->hold = HOLD_PERIODS;
+}
+
+bool rate_controller_update(rate_controller_handle_t controller, const rate_sample_t *s)
+{
+    struct rate_controller *c = controller;
+    const rate_controller_config_t *cfg = &c->config;
+
+    if (s->frames == 0 && s->errors == 0 && s->dropped == 0 && s->queued == 0)
+    {
+        return false;  // Nothing was uploaded, so nothing was learned
+    }
+    uint32_t sample_bps = 0;
+    if (s->busy_ms > 0)
+    {
+        uint64_t bps = s->bytes * 1000 / s->busy_ms;
+        sample_bps = bps > UINT32_MAX ? UINT32_MAX : (uint32_t)bps;
+        // Exponential moving average with weight 1/4
+        c->throughput = c->throughput == 0 ? sample_bps
+                                           : (uint32_t)(((uint64_t)c->throughput * 3 + sample_bps) / 4);
+    }
+
+    bool failing = s->errors > 0 && s->errors * 4 >= s->frames + s->errors;
+    // A link busy for the whole period with frames still waiting is falling further behind
+    bool saturated = s->queued > 0 && (uint64_t)s->busy_ms * 10 >= (uint64_t)s->period_ms * 9;
+    bool severe = s->dropped > 0 || saturated || s->latency_ms > 2 * cfg->target_latency_ms;
+    bool congested = severe || failing || s->queued > cfg->max_queued || s->latency_ms > cfg->target_latency_ms;
+
+    if (c->hold > 0)
+    {
+        c->hold--;
+        if (!severe)
+        {
+            return false;
+        }
+    }
+
+    if (congested)
+    {
+        c->good_periods = 0;
+        if (c->probing)
+        {
+            c->backoff = c->backoff * 2 > MAX_BACKOFF ? MAX_BACKOFF : c->backoff * 2;
+        }
+        if (c->level == 0)
+        {
+            c->probing = false;
+            return false;
+        }
+        // Land on a level with room to drain the backlog. The average lags a
+        // link that just got slower, so this period's rate counts if lower.
+        uint32_t link = sample_bps && sample_bps < c->throughput ? sample_bps : c->throughput;
+        size_t step = severe ? 2 : 1;
+        size_t level = c->level > step ? c->level - step : 0;
+        while (level > 0 && !fits(c, level, link, FIT_PCT))
+        {
+            level--;
+        }
+        set_level(c, level);
+        return true;
+    }
+
+    // With per-level rates the link's load is what this level needs of the
+    // measured throughput, which also holds when a period is shorter than the
+    // capture interval; without them it is the share of this period spent busy
+    bool light = cfg->level_bps && cfg->level_bps[c->level] && c->throughput
+                     ? fits(c, c->level, c->throughput, cfg->up_busy_pct)
+                     : (uint64_t)s->busy_ms * 100 <= (uint64_t)cfg->up_busy_pct * s->period_ms;
+    bool headroom = s->latency_ms * 2 <= cfg->target_latency_ms && s->queued == 0 && light;
+    if (!headroom)
+    {
+        c->good_periods = 0;
+        return false;
+    }
+
+    c->good_periods++;
+    if (c->probing && c->good_periods >= cfg->up_periods)
+    {
+        // The new level held up; forgive one earlier failed probe
+        c->probing = false;
+        c->backoff = c->backoff > 1 ? c->backoff / 2 : 1;
+    }
+    if (c->good_periods >= cfg->up_periods * c->backoff && c->level + 1 < cfg->num_levels &&
+        fits(c, c->level + 1, c->throughput, FIT_PCT))
+    {
+        set_level(c, c->level + 1);
+        return true;
+    }
+    return false;
+}
+
+size_t rate_controller_get_level(rate_controller_handle_t controller)
+{
+    return controller->level;
+}
+
+uint32_t rate_controller_get_throughput(rate_controller_handle_t controller)
+{
+    return controller->throughput;
+}
+
+void rate_controller_delete(rate_controller_handle_t controller)
+{
+    free(controller);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Feedback controller that picks a capture level (a step on a ladder of
+// quality and capture interval, cheapest first) from what the upload
+// path measured over the last period. The caller owns the ladder and applies
+// the chosen level; the controller only sees level indices and samples.
+//
+// The link's throughput while busy (bytes sent over time spent sending and
+// waiting for responses) is smoothed across periods and compared with the
+// bytes per second each level needs. Congestion (frames dropped or piling up
+// in the queue, latency above target, many failed uploads) steps down at
+// once, two levels if frames are being dropped, the link is saturated or
+// latency is twice the target, and further to the highest level the measured
+// throughput can carry. Headroom (low latency, empty queue, link busy only
+// part of the time) has to last a number of periods, and the next level has
+// to fit well within the measured throughput, before the controller steps
+// up. A step up that is followed by congestion doubles the number of periods
+// needed next time, so a link that cannot carry the next level is not probed
+// over and over. Decisions use integer arithmetic only, so a sample trace
+// always produces the same levels.
+
+typedef struct {
+    size_t num_levels;
+    size_t initial_level;
+    uint32_t target_latency_ms;   // Mean capture-to-upload latency to stay under
+    uint32_t max_queued;          // More frames than this waiting for upload is congestion
+    uint32_t up_busy_pct;         // Step up only while the link is busy less than this share of the period
+    uint32_t up_periods;          // Periods of headroom in a row before stepping up
+    const uint32_t *level_bps;    // Bytes per second each level needs, or NULL to go by headroom alone.
+                                  // Read on every update, so the caller may refine it as it learns frame sizes.
+} rate_controller_config_t;
+
+// What the upload path did during one control period
+typedef struct {
+    uint32_t period_ms;
+    uint32_t frames;              // Uploads completed
+    uint32_t errors;              // Uploads failed
+    uint32_t dropped;             // Frames dropped because the queue was full
+    uint32_t queued;              // Frames waiting for upload at the end of the period
+    uint32_t busy_ms;             // Time spent sending and waiting for responses
+    uint64_t bytes;               // Bytes sent
+    uint32_t latency_ms;          // Mean capture-to-upload latency, 0 if no frame finished
+} rate_sample_t;
+
+typedef struct rate_controller *rate_controller_handle_t;
+
+esp_err_t rate_controller_create(const rate_controller_config_t *config, rate_controller_handle_t *out_controller);
+
+// Feed one period. Returns true if the level changed.
+bool rate_controller_update(rate_controller_handle_t controller, const rate_sample_t *sample);
+
+size_t rate_controller_get_level(rate_controller_handle_t controller);
+
+// Smoothed link throughput while busy, in bytes per second; 0 until measured
+uint32_t rate_controller_get_throughput(rate_controller_handle_t controller);
+
+void rate_controller_delete(rate_controller_handle_t controller);
+
+#ifdef __cplusplus
+}
+#endif
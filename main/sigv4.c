@@ -0,0 +1,414 @@
+#include "sigv4.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mbedtls/md.h>
+
+#define ALGORITHM       "AWS4-HMAC-SHA256"
+#define AMZ_DATE_LEN    16              // YYYYMMDDTHHMMSSZ
+#define DATE_LEN        8               // YYYYMMDD
+#define MAX_SCOPE_LEN   96
+#define MAX_PATH_LEN    256
+#define MAX_CRED_LEN    160             // URI-encoded access key ID plus scope
+
+struct sigv4_signer {
+    char *access_key_id;
+    char *secret_access_key;
+    char *region;
+    char *service;
+    char key_date[DATE_LEN + 1];        // Date the cached signing key was derived for
+    mbedtls_md_context_t hmac;          // Keyed with the signing key of key_date
+};
+
+static void to_hex(const uint8_t *bin, size_t len, char *hex)
+{
+    static const char digits[] = "0123456789abcdef";
+
+    for (size_t i = 0; i < len; i++)
+    {
+        hex[2 * i] = digits[bin[i] >> 4];
+        hex[2 * i + 1] = digits[bin[i] & 0x0f];
+    }
+    hex[2 * len] = '\0';
+}
+
+static void hmac_sha256(const uint8_t *key, size_t key_len, const char *msg, uint8_t out[32])
+{
+    mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), key, key_len,
+                    (const uint8_t *)msg, strlen(msg), out);
+}
+
+static char *dup_string(const char *s)
+{
+    return s ? strdup(s) : NULL;
+}
+
+esp_err_t sigv4_signer_create(const sigv4_config_t *config, sigv4_signer_handle_t *out_signer)
+{
+    if (!config || !config->access_key_id || !config->secret_access_key ||
+        !config->region || !config->service || !out_signer)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct sigv4_signer *signer = calloc(1, sizeof(*signer));
+    if (!signer)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    mbedtls_md_init(&signer->hmac);
+    signer->access_key_id = dup_string(config->access_key_id);
+    signer->secret_access_key = dup_string(config->secret_access_key);
+    signer->region = dup_string(config->region);
+    signer->service = dup_string(config->service);
+    if (!signer->access_key_id || !signer->secret_access_key || !signer->region || !signer->service ||
+        mbedtls_md_setup(&signer->hmac, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 1) != 0)
+    {
+        sigv4_signer_delete(signer);
+        return ESP_ERR_NO_MEM;
+    }
+
+    *out_signer = signer;
+    return ESP_OK;
+}
+
+void sigv4_signer_delete(sigv4_signer_handle_t signer)
+{
+    if (!signer)
+    {
+        return;
+    }
+    mbedtls_md_free(&signer->hmac);
+    if (signer->secret_access_key)
+    {
+        memset(signer->secret_access_key, 0, strlen(signer->secret_access_key));
+    }
+    free(signer->access_key_id);
+    free(signer->secret_access_key);
+    free(signer->region);
+    free(signer->service);
+    free(signer);
+}
+
+// Derive the signing key for date and key the HMAC context with it. The four
+// HMACs of the derivation run once per date. Later requests only reset the
+// context, which restarts the inner hash by processing the ipad block it
+// stored when it was keyed; the key itself is not derived again.
+static esp_err_t update_signing_key(struct sigv4_signer *signer, const char *date)
+{
+    uint8_t key[32];
+    size_t secret_len = strlen(signer->secret_access_key);
+
+    if (strcmp(signer->key_date, date) == 0)
+    {
+        return mbedtls_md_hmac_reset(&signer->hmac) == 0 ? ESP_OK : ESP_FAIL;
+    }
+
+    uint8_t *secret = malloc(secret_len + 4);
+    if (!secret)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(secret, "AWS4", 4);
+    memcpy(secret + 4, signer->secret_access_key, secret_len);
+    hmac_sha256(secret, secret_len + 4, date, key);
+    memset(secret, 0, secret_len + 4);
+    free(secret);
+
+    hmac_sha256(key, sizeof(key), signer->region, key);
+    hmac_sha256(key, sizeof(key), signer->service, key);
+    hmac_sha256(key, sizeof(key), "aws4_request", key);
+
+    int ret = mbedtls_md_hmac_starts(&signer->hmac, key, sizeof(key));
+    memset(key, 0, sizeof(key));
+    if (ret != 0)
+    {
+        signer->key_date[0] = '\0';
+        return ESP_FAIL;
+    }
+    memcpy(signer->key_date, date, DATE_LEN + 1);
+    return ESP_OK;
+}
+
+static void format_amz_date(time_t t, char *amz_date)
+{
+    struct tm tm;
+
+    gmtime_r(&t, &tm);
+    strftime(amz_date, AMZ_DATE_LEN + 1, "%Y%m%dT%H%M%SZ", &tm);
+}
+
+// Credential scope: date/region/service/aws4_request, with sep between the parts
+static int format_scope(const struct sigv4_signer *signer, const char *date, const char *sep,
+                        char *scope, size_t len)
+{
+    return snprintf(scope, len, "%.8s%s%s%s%s%saws4_request",
+                    date, sep, signer->region, sep, signer->service, sep);
+}
+
+static inline void sha_str(mbedtls_sha256_context *sha, const char *s)
+{
+    mbedtls_sha256_update(sha, (const uint8_t *)s, strlen(s));
+}
+
+esp_err_t sigv4_sign(sigv4_signer_handle_t signer, const sigv4_request_t *request, char *signature)
+{
+    char amz_date[AMZ_DATE_LEN + 1];
+    char date[DATE_LEN + 1];
+    char scope[MAX_SCOPE_LEN];
+    uint8_t digest[32];
+    char hex[SIGV4_HEX_LEN + 1];
+
+    if (!signer || !request || !request->method || !request->path || !request->payload_hash || !signature)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    format_amz_date(request->time, amz_date);
+    memcpy(date, amz_date, DATE_LEN);
+    date[DATE_LEN] = '\0';
+    if (format_scope(signer, date, "/", scope, sizeof(scope)) >= (int)sizeof(scope))
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    // Hash the canonical request as it is produced
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    sha_str(&sha, request->method);
+    sha_str(&sha, "\n");
+    sha_str(&sha, request->path);
+    sha_str(&sha, "\n");
+    sha_str(&sha, request->query ? request->query : "");
+    sha_str(&sha, "\n");
+    for (size_t i = 0; i < request->num_headers; i++)
+    {
+        sha_str(&sha, request->headers[i].name);
+        sha_str(&sha, ":");
+        sha_str(&sha, request->headers[i].value);
+        sha_str(&sha, "\n");
+    }
+    sha_str(&sha, "\n");
+    for (size_t i = 0; i < request->num_headers; i++)
+    {
+        if (i > 0)
+        {
+            sha_str(&sha, ";");
+        }
+        sha_str(&sha, request->headers[i].name);
+    }
+    sha_str(&sha, "\n");
+    sha_str(&sha, request->payload_hash);
+    mbedtls_sha256_finish(&sha, digest);
+    mbedtls_sha256_free(&sha);
+    to_hex(digest, sizeof(digest), hex);
+
+    esp_err_t err = update_signing_key(signer, date);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+
+    // String to sign
+    mbedtls_md_context_t *hmac = &signer->hmac;
+    mbedtls_md_hmac_update(hmac, (const uint8_t *)ALGORITHM "\n", sizeof(ALGORITHM));
+    mbedtls_md_hmac_update(hmac, (const uint8_t *)amz_date, AMZ_DATE_LEN);
+    mbedtls_md_hmac_update(hmac, (const uint8_t *)"\n", 1);
+    mbedtls_md_hmac_update(hmac, (const uint8_t *)scope, strlen(scope));
+    mbedtls_md_hmac_update(hmac, (const uint8_t *)"\n", 1);
+    mbedtls_md_hmac_update(hmac, (const uint8_t *)hex, SIGV4_HEX_LEN);
+    if (mbedtls_md_hmac_finish(hmac, digest) != 0)
+    {
+        return ESP_FAIL;
+    }
+    to_hex(digest, sizeof(digest), signature);
+    return ESP_OK;
+}
+
+esp_err_t sigv4_uri_encode(const char *src, bool encode_slash, char *dst, size_t dst_len)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    size_t n = 0;
+
+    for (const uint8_t *p = (const uint8_t *)src; *p; p++)
+    {
+        uint8_t c = *p;
+        bool unreserved = (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+                          c == '-' || c == '_' || c == '.' || c == '~' || (c == '/' && !encode_slash);
+        if (n + (unreserved ? 1 : 3) >= dst_len)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        if (unreserved)
+        {
+            dst[n++] = c;
+        }
+        else
+        {
+            dst[n++] = '%';
+            dst[n++] = digits[c >> 4];
+            dst[n++] = digits[c & 0x0f];
+        }
+    }
+    if (n >= dst_len)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    dst[n] = '\0';
+    return ESP_OK;
+}
+
+// "/" followed by the encoded object key
+static esp_err_t encode_key_path(const char *key, char *path, size_t len)
+{
+    path[0] = '/';
+    return sigv4_uri_encode(key[0] == '/' ? key + 1 : key, false, path + 1, len - 1);
+}
+
+esp_err_t sigv4_presign_url(sigv4_signer_handle_t signer, const char *method, const char *host,
+                            const char *key, time_t now, uint32_t expires_s, char *url, size_t url_len)
+{
+    char path[MAX_PATH_LEN];
+    char amz_date[AMZ_DATE_LEN + 1];
+    char credential[MAX_CRED_LEN];
+    char signature[SIGV4_HEX_LEN + 1];
+    esp_err_t err;
+
+    if (!signer || !method || !host || !key || !url)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if ((err = encode_key_path(key, path, sizeof(path))) != ESP_OK ||
+        (err = sigv4_uri_encode(signer->access_key_id, true, credential, sizeof(credential))) != ESP_OK)
+    {
+        return err;
+    }
+    format_amz_date(now, amz_date);
+    size_t cred_len = strlen(credential);
+    if (cred_len + 3 + (size_t)format_scope(signer, amz_date, "%2F", credential + cred_len + 3,
+                                            sizeof(credential) - cred_len - 3) >= sizeof(credential))
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(credential + cred_len, "%2F", 3);
+
+    // The URL doubles as the buffer for the canonical query, which is its tail
+    int n = snprintf(url, url_len, "https://%s%s?", host, path);
+    if (n < 0 || (size_t)n >= url_len)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    char *query = url + n;
+    int q = snprintf(query, url_len - n,
+                     "X-Amz-Algorithm=" ALGORITHM "&X-Amz-Credential=%s&X-Amz-Date=%s"
+                     "&X-Amz-Expires=%" PRIu32 "&X-Amz-SignedHeaders=host",
+                     credential, amz_date, expires_s);
+    if (q < 0 || (size_t)q >= url_len - n)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    const sigv4_header_t headers[] = {
+        { "host", host },
+    };
+    const sigv4_request_t request = {
+        .method = method,
+        .path = path,
+        .query = query,
+        .headers = headers,
+        .num_headers = 1,
+        .payload_hash = SIGV4_UNSIGNED_PAYLOAD,
+        .time = now,
+    };
+    if ((err = sigv4_sign(signer, &request, signature)) != ESP_OK)
+    {
+        return err;
+    }
+
+    n += q;
+    q = snprintf(url + n, url_len - n, "&X-Amz-Signature=%s", signature);
+    if (q < 0 || (size_t)q >= url_len - n)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return ESP_OK;
+}
+
+esp_err_t sigv4_sign_headers(sigv4_signer_handle_t signer, const char *method, const char *host,
+                             const char *key, time_t now, const char *payload_hash,
+                             char *headers, size_t headers_len)
+{
+    char path[MAX_PATH_LEN];
+    char amz_date[AMZ_DATE_LEN + 1];
+    char scope[MAX_SCOPE_LEN];
+    char signature[SIGV4_HEX_LEN + 1];
+    esp_err_t err;
+
+    if (!signer || !method || !host || !key || !payload_hash || !headers)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if ((err = encode_key_path(key, path, sizeof(path))) != ESP_OK)
+    {
+        return err;
+    }
+    format_amz_date(now, amz_date);
+    if (format_scope(signer, amz_date, "/", scope, sizeof(scope)) >= (int)sizeof(scope))
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    const sigv4_header_t signed_headers[] = {
+        { "host", host },
+        { "x-amz-content-sha256", payload_hash },
+        { "x-amz-date", amz_date },
+    };
+    const sigv4_request_t request = {
+        .method = method,
+        .path = path,
+        .query = NULL,
+        .headers = signed_headers,
+        .num_headers = sizeof(signed_headers) / sizeof(signed_headers[0]),
+        .payload_hash = payload_hash,
+        .time = now,
+    };
+    if ((err = sigv4_sign(signer, &request, signature)) != ESP_OK)
+    {
+        return err;
+    }
+
+    int n = snprintf(headers, headers_len,
+                     "x-amz-date: %s\r\n"
+                     "x-amz-content-sha256: %s\r\n"
+                     "Authorization: " ALGORITHM " Credential=%s/%s, "
+                     "SignedHeaders=host;x-amz-content-sha256;x-amz-date, Signature=%s\r\n",
+                     amz_date, payload_hash, signer->access_key_id, scope, signature);
+    if (n < 0 || (size_t)n >= headers_len)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return ESP_OK;
+}
+
+void sigv4_payload_hash_start(sigv4_payload_hash_t *hash)
+{
+    mbedtls_sha256_init(&hash->sha);
+    mbedtls_sha256_starts(&hash->sha, 0);
+}
+
+void sigv4_payload_hash_update(sigv4_payload_hash_t *hash, const void *data, size_t len)
+{
+    mbedtls_sha256_update(&hash->sha, data, len);
+}
+
+void sigv4_payload_hash_finish(sigv4_payload_hash_t *hash, char *hex)
+{
+    uint8_t digest[32];
+
+    mbedtls_sha256_finish(&hash->sha, digest);
+    mbedtls_sha256_free(&hash->sha);
+    to_hex(digest, sizeof(digest), hex);
+}
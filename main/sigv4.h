@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <esp_err.h>
+#include <mbedtls/sha256.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// AWS Signature Version 4 request signing. The signing key derived from the
+// secret, date, region and service is cached until the UTC date changes, so
+// signing a request costs one SHA-256 over the canonical request and one HMAC.
+// The canonical request is hashed piece by piece and never assembled in memory.
+//
+// A signer is not thread-safe; use one per task.
+
+#define SIGV4_HEX_LEN           64                  // Hex SHA-256 digest or signature
+#define SIGV4_UNSIGNED_PAYLOAD  "UNSIGNED-PAYLOAD"
+
+typedef struct {
+    const char *access_key_id;
+    const char *secret_access_key;
+    const char *region;             // e.g. "eu-north-1"
+    const char *service;            // e.g. "s3"
+} sigv4_config_t;
+
+typedef struct {
+    const char *name;               // Lowercase
+    const char *value;              // Without leading or trailing spaces
+} sigv4_header_t;
+
+// A request in canonical form
+typedef struct {
+    const char *method;
+    const char *path;               // URI-encoded absolute path
+    const char *query;              // Canonical query string (sorted, encoded), NULL if none
+    const sigv4_header_t *headers;  // Sorted by name, including host
+    size_t num_headers;
+    const char *payload_hash;       // Hex SHA-256 of the body, or SIGV4_UNSIGNED_PAYLOAD
+    time_t time;                    // Request time; also used for the credential scope
+} sigv4_request_t;
+
+typedef struct sigv4_signer *sigv4_signer_handle_t;
+
+esp_err_t sigv4_signer_create(const sigv4_config_t *config, sigv4_signer_handle_t *out_signer);
+
+void sigv4_signer_delete(sigv4_signer_handle_t signer);
+
+// Compute the signature of a canonical request into signature (SIGV4_HEX_LEN + 1 bytes)
+esp_err_t sigv4_sign(sigv4_signer_handle_t signer, const sigv4_request_t *request, char *signature);
+
+// Build a presigned https URL for method on host/key, valid for expires_s seconds.
+// The key is URI-encoded here. The payload is not signed.
+esp_err_t sigv4_presign_url(sigv4_signer_handle_t signer, const char *method, const char *host,
+                            const char *key, time_t now, uint32_t expires_s, char *url, size_t url_len);
+
+// Sign a request in the Authorization header instead of the URL. Writes the
+// x-amz-date, x-amz-content-sha256 and Authorization header lines, each ending
+// in "\r\n", in the form http_uploader_begin() takes as extra headers.
+esp_err_t sigv4_sign_headers(sigv4_signer_handle_t signer, const char *method, const char *host,
+                             const char *key, time_t now, const char *payload_hash,
+                             char *headers, size_t headers_len);
+
+// URI-encode src as SigV4 requires. '/' is kept when encode_slash is false.
+// Returns ESP_ERR_INVALID_SIZE if the result does not fit.
+esp_err_t sigv4_uri_encode(const char *src, bool encode_slash, char *dst, size_t dst_len);
+
+// Streaming SHA-256 of a request body, so a body that is produced or read in
+// pieces can be hashed as it goes instead of being buffered first
+typedef struct {
+    mbedtls_sha256_context sha;
+} sigv4_payload_hash_t;
+
+void sigv4_payload_hash_start(sigv4_payload_hash_t *hash);
+
+void sigv4_payload_hash_update(sigv4_payload_hash_t *hash, const void *data, size_t len);
+
+// Write the lowercase hex digest (SIGV4_HEX_LEN + 1 bytes) and release the context
+void sigv4_payload_hash_finish(sigv4_payload_hash_t *hash, char *hex);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,113 @@
+#include "cJSON.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+cJSON *cJSON_CreateObject(void)
+{
+    cJSON *item = calloc(1, sizeof(*item));
+    if (item)
+    {
+        item->type = cJSON_Object;
+    }
+    return item;
+}
+
+static cJSON *add_item(cJSON *object, const char *name, int type)
+{
+    if (!object)
+    {
+        return NULL;
+    }
+    cJSON *item = calloc(1, sizeof(*item));
+    if (!item || !(item->string = strdup(name)))
+    {
+        free(item);
+        return NULL;
+    }
+    item->type = type;
+
+    cJSON **tail = &object->child;
+    while (*tail)
+    {
+        tail = &(*tail)->next;
+    }
+    *tail = item;
+    return item;
+}
+
+cJSON *cJSON_AddObjectToObject(cJSON *object, const char *name)
+{
+    return add_item(object, name, cJSON_Object);
+}
+
+cJSON *cJSON_AddNumberToObject(cJSON *object, const char *name, double number)
+{
+    cJSON *item = add_item(object, name, cJSON_Number);
+    if (item)
+    {
+        item->valuedouble = number;
+    }
+    return item;
+}
+
+cJSON *cJSON_GetObjectItem(const cJSON *object, const char *name)
+{
+    for (cJSON *item = object ? object->child : NULL; item; item = item->next)
+    {
+        if (strcmp(item->string, name) == 0)
+        {
+            return item;
+        }
+    }
+    return NULL;
+}
+
+static void print_item(FILE *out, const cJSON *item)
+{
+    if (item->type == cJSON_Number)
+    {
+        fprintf(out, "%.17g", item->valuedouble);
+        return;
+    }
+    fputc('{', out);
+    for (const cJSON *child = item->child; child; child = child->next)
+    {
+        fprintf(out, "%s\"%s\":", child == item->child ? "" : ",", child->string);
+        print_item(out, child);
+    }
+    fputc('}', out);
+}
+
+char *cJSON_PrintUnformatted(const cJSON *item)
+{
+    char *text = NULL;
+    size_t len = 0;
+    FILE *out = open_memstream(&text, &len);
+
+    if (!out)
+    {
+        return NULL;
+    }
+    print_item(out, item);
+    fclose(out);
+    return text;
+}
+
+void cJSON_Delete(cJSON *item)
+{
+    while (item)
+    {
+        cJSON *next = item->next;
+        cJSON_Delete(item->child);
+        free(item->string);
+        free(item);
+        item = next;
+    }
+}
+
+void cJSON_free(void *ptr)
+{
+    free(ptr);
+}
@@ -0,0 +1,144 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <esp_tls.h>
+
+struct esp_tls {
+    int fd;
+};
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static host_tls_stats_t s_stats;
+static int s_sndbuf;
+
+esp_tls_t *esp_tls_init(void)
+{
+    esp_tls_t *tls = calloc(1, sizeof(*tls));
+    if (tls)
+    {
+        tls->fd = -1;
+    }
+    return tls;
+}
+
+int esp_tls_conn_new_sync(const char *hostname, int hostlen, int port, const esp_tls_cfg_t *cfg, esp_tls_t *tls)
+{
+    char host[256];
+    char service[8];
+    struct addrinfo hints = { .ai_socktype = SOCK_STREAM };
+    struct addrinfo *res;
+
+    snprintf(host, sizeof(host), "%.*s", hostlen, hostname);
+    snprintf(service, sizeof(service), "%d", port);
+    pthread_mutex_lock(&s_lock);
+    snprintf(s_stats.hostname, sizeof(s_stats.hostname), "%s", host);
+    snprintf(s_stats.common_name, sizeof(s_stats.common_name), "%s", cfg->common_name ? cfg->common_name : "");
+    s_stats.port = port;
+    s_stats.connects++;
+    int sndbuf = s_sndbuf;
+    pthread_mutex_unlock(&s_lock);
+
+    if (getaddrinfo(host, service, &hints, &res) != 0)
+    {
+        return -1;
+    }
+    tls->fd = socket(res->ai_family, SOCK_STREAM, 0);
+    if (tls->fd >= 0 && sndbuf > 0)
+    {
+        setsockopt(tls->fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    }
+    int ok = tls->fd >= 0 && connect(tls->fd, res->ai_addr, res->ai_addrlen) == 0;
+    freeaddrinfo(res);
+    if (!ok)
+    {
+        return -1;
+    }
+    fcntl(tls->fd, F_SETFL, fcntl(tls->fd, F_GETFL) | O_NONBLOCK);
+    return 1;
+}
+
+static ssize_t want(ssize_t code)
+{
+    pthread_mutex_lock(&s_lock);
+    s_stats.want_results++;
+    pthread_mutex_unlock(&s_lock);
+    return code;
+}
+
+ssize_t esp_tls_conn_write(esp_tls_t *tls, const void *data, size_t datalen)
+{
+    int nodelay = 0;
+    socklen_t optlen = sizeof(nodelay);
+    getsockopt(tls->fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, &optlen);
+    pthread_mutex_lock(&s_lock);
+    s_stats.nodelay = nodelay;
+    pthread_mutex_unlock(&s_lock);
+
+    ssize_t n = send(tls->fd, data, datalen, MSG_NOSIGNAL);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    {
+        return want(ESP_TLS_ERR_SSL_WANT_WRITE);
+    }
+    return n < 0 ? -1 : n;
+}
+
+ssize_t esp_tls_conn_read(esp_tls_t *tls, void *data, size_t datalen)
+{
+    ssize_t n = recv(tls->fd, data, datalen, 0);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    {
+        return want(ESP_TLS_ERR_SSL_WANT_READ);
+    }
+    return n < 0 ? -1 : n;
+}
+
+int esp_tls_conn_destroy(esp_tls_t *tls)
+{
+    if (tls->fd >= 0)
+    {
+        close(tls->fd);
+    }
+    free(tls);
+    return 0;
+}
+
+esp_err_t esp_tls_get_conn_sockfd(esp_tls_t *tls, int *sockfd)
+{
+    if (!tls || !sockfd)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *sockfd = tls->fd;
+    return ESP_OK;
+}
+
+esp_tls_client_session_t *esp_tls_get_client_session(esp_tls_t *tls)
+{
+    return NULL;
+}
+
+void esp_tls_free_client_session(esp_tls_client_session_t *session)
+{
+}
+
+void host_tls_get_stats(host_tls_stats_t *out_stats)
+{
+    pthread_mutex_lock(&s_lock);
+    *out_stats = s_stats;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_tls_set_sndbuf(int bytes)
+{
+    pthread_mutex_lock(&s_lock);
+    s_sndbuf = bytes;
+    pthread_mutex_unlock(&s_lock);
+}
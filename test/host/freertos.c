@@ -0,0 +1,321 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/event_groups.h>
+
+// FreeRTOS on pthreads: just enough of the API for the project's tasks to
+// run unchanged on a host. Blocking calls honour their timeouts, so code that
+// polls for a stop request behaves as on the device.
+
+static uint64_t monotonic_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Absolute deadline for pthread_cond_timedwait, which uses CLOCK_REALTIME
+static struct timespec deadline_after(TickType_t ticks)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    if (ticks == portMAX_DELAY)
+    {
+        ts.tv_sec += 365 * 24 * 3600;
+        return ts;
+    }
+    ts.tv_sec += ticks / 1000;
+    ts.tv_nsec += (long)(ticks % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000)
+    {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    return ts;
+}
+
+// Wait on cond until pred holds or ticks run out; called with the mutex held
+#define WAIT_UNTIL(cond, mutex, ticks, pred)                                      \
+    ({                                                                            \
+        struct timespec deadline_ = deadline_after(ticks);                        \
+        int ok_ = 1;                                                              \
+        while (!(pred))                                                           \
+        {                                                                         \
+            if ((ticks) == 0 ||                                                   \
+                pthread_cond_timedwait(cond, mutex, &deadline_) == ETIMEDOUT)     \
+            {                                                                     \
+                ok_ = (pred);                                                     \
+                break;                                                            \
+            }                                                                     \
+        }                                                                         \
+        ok_;                                                                      \
+    })
+
+typedef struct {
+    TaskFunction_t fn;
+    void *arg;
+} task_start_t;
+
+static void *task_main(void *p)
+{
+    task_start_t start = *(task_start_t *)p;
+
+    free(p);
+    start.fn(start.arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_size, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *out_task, BaseType_t core)
+{
+    (void)name;
+    (void)stack_size;
+    (void)priority;
+    (void)core;
+
+    task_start_t *start = malloc(sizeof(*start));
+    pthread_t thread;
+    if (!start)
+    {
+        return pdFAIL;
+    }
+    start->fn = fn;
+    start->arg = arg;
+    if (pthread_create(&thread, NULL, task_main, start) != 0)
+    {
+        free(start);
+        return pdFAIL;
+    }
+    pthread_detach(thread);
+    if (out_task)
+    {
+        *out_task = NULL;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_size, void *arg,
+                       UBaseType_t priority, TaskHandle_t *out_task)
+{
+    return xTaskCreatePinnedToCore(fn, name, stack_size, arg, priority, out_task, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task)
+    {
+        fprintf(stderr, "vTaskDelete of another task is not supported on the host\n");
+        abort();
+    }
+    pthread_exit(NULL);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec ts = { ticks / 1000, (long)(ticks % 1000) * 1000000 };
+
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+    {
+    }
+}
+
+void vTaskDelayUntil(TickType_t *previous_wake, TickType_t period)
+{
+    TickType_t wake = *previous_wake + period;
+    TickType_t now = xTaskGetTickCount();
+
+    if ((int32_t)(wake - now) > 0)
+    {
+        vTaskDelay(wake - now);
+    }
+    *previous_wake = wake;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)monotonic_ms();
+}
+
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    size_t length;
+    size_t item_size;
+    size_t head;
+    size_t count;
+    unsigned char *items;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct host_queue *q = calloc(1, sizeof(*q));
+    if (!q || !(q->items = calloc(length, item_size)))
+    {
+        free(q);
+        return NULL;
+    }
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->changed, NULL);
+    q->length = length;
+    q->item_size = item_size;
+    return q;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks)
+{
+    pthread_mutex_lock(&q->lock);
+    if (!WAIT_UNTIL(&q->changed, &q->lock, ticks, q->count < q->length))
+    {
+        pthread_mutex_unlock(&q->lock);
+        return pdFALSE;
+    }
+    memcpy(q->items + (q->head + q->count) % q->length * q->item_size, item, q->item_size);
+    q->count++;
+    pthread_cond_broadcast(&q->changed);
+    pthread_mutex_unlock(&q->lock);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks)
+{
+    pthread_mutex_lock(&q->lock);
+    if (!WAIT_UNTIL(&q->changed, &q->lock, ticks, q->count > 0))
+    {
+        pthread_mutex_unlock(&q->lock);
+        return pdFALSE;
+    }
+    memcpy(item, q->items + q->head * q->item_size, q->item_size);
+    q->head = (q->head + 1) % q->length;
+    q->count--;
+    pthread_cond_broadcast(&q->changed);
+    pthread_mutex_unlock(&q->lock);
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->lock);
+    UBaseType_t count = q->count;
+    pthread_mutex_unlock(&q->lock);
+    return count;
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->changed);
+    free(q->items);
+    free(q);
+}
+
+struct host_mutex {
+    pthread_mutex_t lock;
+};
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    struct host_mutex *m = malloc(sizeof(*m));
+    if (m)
+    {
+        pthread_mutex_init(&m->lock, NULL);
+    }
+    return m;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t m, TickType_t ticks)
+{
+    if (ticks != portMAX_DELAY)
+    {
+        struct timespec deadline = deadline_after(ticks);
+        return pthread_mutex_timedlock(&m->lock, &deadline) == 0 ? pdTRUE : pdFALSE;
+    }
+    pthread_mutex_lock(&m->lock);
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t m)
+{
+    pthread_mutex_unlock(&m->lock);
+    return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t m)
+{
+    pthread_mutex_destroy(&m->lock);
+    free(m);
+}
+
+struct host_event_group {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    EventBits_t bits;
+};
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    struct host_event_group *g = calloc(1, sizeof(*g));
+    if (g)
+    {
+        pthread_mutex_init(&g->lock, NULL);
+        pthread_cond_init(&g->changed, NULL);
+    }
+    return g;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t g, EventBits_t bits)
+{
+    pthread_mutex_lock(&g->lock);
+    g->bits |= bits;
+    EventBits_t now = g->bits;
+    pthread_cond_broadcast(&g->changed);
+    pthread_mutex_unlock(&g->lock);
+    return now;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t g, EventBits_t bits)
+{
+    pthread_mutex_lock(&g->lock);
+    EventBits_t before = g->bits;
+    g->bits &= ~bits;
+    pthread_mutex_unlock(&g->lock);
+    return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t g)
+{
+    pthread_mutex_lock(&g->lock);
+    EventBits_t now = g->bits;
+    pthread_mutex_unlock(&g->lock);
+    return now;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t g, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t ticks)
+{
+    pthread_mutex_lock(&g->lock);
+    int met = WAIT_UNTIL(&g->changed, &g->lock, ticks,
+                         wait_for_all ? (g->bits & bits) == bits : (g->bits & bits) != 0);
+    EventBits_t now = g->bits;
+    if (met && clear_on_exit)
+    {
+        g->bits &= ~bits;
+    }
+    pthread_mutex_unlock(&g->lock);
+    return now;
+}
+
+void vEventGroupDelete(EventGroupHandle_t g)
+{
+    pthread_mutex_destroy(&g->lock);
+    pthread_cond_destroy(&g->changed);
+    free(g);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+// Host stand-in for the subset of cJSON the project uses. Nodes keep cJSON's
+// field names, so tests can walk a snapshot the way they would with the real
+// library.
+
+#define cJSON_Number (1 << 3)
+#define cJSON_Object (1 << 6)
+
+typedef struct cJSON {
+    struct cJSON *next;
+    struct cJSON *child;
+    int type;
+    double valuedouble;
+    char *string;
+} cJSON;
+
+cJSON *cJSON_CreateObject(void);
+cJSON *cJSON_AddObjectToObject(cJSON *object, const char *name);
+cJSON *cJSON_AddNumberToObject(cJSON *object, const char *name, double number);
+cJSON *cJSON_GetObjectItem(const cJSON *object, const char *name);
+char *cJSON_PrintUnformatted(const cJSON *item);
+void cJSON_Delete(cJSON *item);
+void cJSON_free(void *ptr);
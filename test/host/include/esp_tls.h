@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <esp_err.h>
+
+// Plain-TCP stand-in for esp_tls. Sockets are non-blocking, so callers see
+// ESP_TLS_ERR_SSL_WANT_READ/WRITE whenever the real stack would block.
+
+#define ESP_TLS_ERR_SSL_WANT_READ  -0x6900
+#define ESP_TLS_ERR_SSL_WANT_WRITE -0x6880
+
+typedef struct esp_tls esp_tls_t;
+typedef struct esp_tls_client_session esp_tls_client_session_t;
+
+typedef struct {
+    const unsigned char *cacert_pem_buf;
+    unsigned int cacert_pem_bytes;
+    int timeout_ms;
+    bool is_plain_tcp;
+    const char *common_name;
+    esp_tls_client_session_t *client_session;
+} esp_tls_cfg_t;
+
+esp_tls_t *esp_tls_init(void);
+int esp_tls_conn_new_sync(const char *hostname, int hostlen, int port, const esp_tls_cfg_t *cfg, esp_tls_t *tls);
+ssize_t esp_tls_conn_write(esp_tls_t *tls, const void *data, size_t datalen);
+ssize_t esp_tls_conn_read(esp_tls_t *tls, void *data, size_t datalen);
+int esp_tls_conn_destroy(esp_tls_t *tls);
+esp_err_t esp_tls_get_conn_sockfd(esp_tls_t *tls, int *sockfd);
+esp_tls_client_session_t *esp_tls_get_client_session(esp_tls_t *tls);
+void esp_tls_free_client_session(esp_tls_client_session_t *session);
+
+// Host only: what the last connect was asked for, how often a call returned
+// WANT_READ/WANT_WRITE, so tests can check callers wait properly, and whether
+// Nagle was off on the socket of the last write
+typedef struct {
+    char hostname[256];
+    char common_name[256];
+    int port;
+    unsigned connects;
+    unsigned want_results;
+    int nodelay;
+} host_tls_stats_t;
+
+void host_tls_get_stats(host_tls_stats_t *out_stats);
+
+// Host only: shrink the socket send buffer of new connections to provoke WANT_WRITE
+void host_tls_set_sndbuf(int bytes);
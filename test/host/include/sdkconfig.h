@@ -0,0 +1,5 @@
+#pragma once
+
+// The project settings the host-built modules depend on
+#define CONFIG_SPIRAM 1
+#define CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS 1
@@ -0,0 +1,214 @@
+#include <string.h>
+#include "mbedtls/md.h"
+
+// Plain C SHA-256 (FIPS 180-4) and HMAC (RFC 2104) behind the mbedtls calls
+// the firmware makes. Slower than the ESP32-S3 SHA accelerator, but exact.
+
+struct mbedtls_md_info_t {
+    mbedtls_md_type_t type;
+};
+
+static const mbedtls_md_info_t s_sha256_info = { MBEDTLS_MD_SHA256 };
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static inline uint32_t ror(uint32_t x, int n)
+{
+    return x >> n | x << (32 - n);
+}
+
+static void sha256_block(uint32_t state[8], const uint8_t *p)
+{
+    uint32_t w[64];
+
+    for (int i = 0; i < 16; i++)
+    {
+        w[i] = (uint32_t)p[4 * i] << 24 | (uint32_t)p[4 * i + 1] << 16 | (uint32_t)p[4 * i + 2] << 8 | p[4 * i + 3];
+    }
+    for (int i = 16; i < 64; i++)
+    {
+        uint32_t s0 = ror(w[i - 15], 7) ^ ror(w[i - 15], 18) ^ w[i - 15] >> 3;
+        uint32_t s1 = ror(w[i - 2], 17) ^ ror(w[i - 2], 19) ^ w[i - 2] >> 10;
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++)
+    {
+        uint32_t t1 = h + (ror(e, 6) ^ ror(e, 11) ^ ror(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+        uint32_t t2 = (ror(a, 2) ^ ror(a, 13) ^ ror(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g, g = f, f = e, e = d + t1;
+        d = c, c = b, b = a, a = t1 + t2;
+    }
+    state[0] += a, state[1] += b, state[2] += c, state[3] += d;
+    state[4] += e, state[5] += f, state[6] += g, state[7] += h;
+}
+
+void mbedtls_sha256_init(mbedtls_sha256_context *ctx)
+{
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+void mbedtls_sha256_free(mbedtls_sha256_context *ctx)
+{
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+int mbedtls_sha256_starts(mbedtls_sha256_context *ctx, int is224)
+{
+    static const uint32_t init[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+
+    if (is224)
+    {
+        return -1;
+    }
+    memcpy(ctx->state, init, sizeof(init));
+    ctx->total = 0;
+    return 0;
+}
+
+int mbedtls_sha256_update(mbedtls_sha256_context *ctx, const unsigned char *input, size_t ilen)
+{
+    size_t fill = ctx->total % 64;
+
+    ctx->total += ilen;
+    if (fill && fill + ilen >= 64)
+    {
+        memcpy(ctx->block + fill, input, 64 - fill);
+        sha256_block(ctx->state, ctx->block);
+        input += 64 - fill;
+        ilen -= 64 - fill;
+        fill = 0;
+    }
+    for (; fill == 0 && ilen >= 64; input += 64, ilen -= 64)
+    {
+        sha256_block(ctx->state, input);
+    }
+    memcpy(ctx->block + fill, input, ilen);
+    return 0;
+}
+
+int mbedtls_sha256_finish(mbedtls_sha256_context *ctx, unsigned char *output)
+{
+    uint64_t bits = ctx->total * 8;
+    uint8_t pad[72] = { 0x80 };
+    size_t pad_len = (ctx->total % 64 < 56 ? 56 : 120) - ctx->total % 64;
+
+    for (int i = 0; i < 8; i++)
+    {
+        pad[pad_len + i] = (uint8_t)(bits >> (56 - 8 * i));
+    }
+    mbedtls_sha256_update(ctx, pad, pad_len + 8);
+    for (int i = 0; i < 8; i++)
+    {
+        output[4 * i] = ctx->state[i] >> 24;
+        output[4 * i + 1] = ctx->state[i] >> 16;
+        output[4 * i + 2] = ctx->state[i] >> 8;
+        output[4 * i + 3] = ctx->state[i];
+    }
+    return 0;
+}
+
+const mbedtls_md_info_t *mbedtls_md_info_from_type(mbedtls_md_type_t md_type)
+{
+    return md_type == MBEDTLS_MD_SHA256 ? &s_sha256_info : NULL;
+}
+
+void mbedtls_md_init(mbedtls_md_context_t *ctx)
+{
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+void mbedtls_md_free(mbedtls_md_context_t *ctx)
+{
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+int mbedtls_md_setup(mbedtls_md_context_t *ctx, const mbedtls_md_info_t *md_info, int hmac)
+{
+    if (!md_info)
+    {
+        return -1;
+    }
+    ctx->md_info = md_info;
+    ctx->hmac = hmac;
+    return 0;
+}
+
+int mbedtls_md_hmac_starts(mbedtls_md_context_t *ctx, const unsigned char *key, size_t keylen)
+{
+    uint8_t k[64] = {0};
+
+    if (!ctx->md_info || !ctx->hmac)
+    {
+        return -1;
+    }
+    if (keylen > sizeof(k))
+    {
+        mbedtls_sha256_starts(&ctx->sha, 0);
+        mbedtls_sha256_update(&ctx->sha, key, keylen);
+        mbedtls_sha256_finish(&ctx->sha, k);
+    }
+    else
+    {
+        memcpy(k, key, keylen);
+    }
+    for (int i = 0; i < 64; i++)
+    {
+        ctx->ipad[i] = k[i] ^ 0x36;
+        ctx->opad[i] = k[i] ^ 0x5c;
+    }
+    return mbedtls_md_hmac_reset(ctx);
+}
+
+int mbedtls_md_hmac_update(mbedtls_md_context_t *ctx, const unsigned char *input, size_t ilen)
+{
+    return mbedtls_sha256_update(&ctx->sha, input, ilen);
+}
+
+int mbedtls_md_hmac_finish(mbedtls_md_context_t *ctx, unsigned char *output)
+{
+    uint8_t inner[32];
+
+    mbedtls_sha256_finish(&ctx->sha, inner);
+    mbedtls_sha256_starts(&ctx->sha, 0);
+    mbedtls_sha256_update(&ctx->sha, ctx->opad, sizeof(ctx->opad));
+    mbedtls_sha256_update(&ctx->sha, inner, sizeof(inner));
+    return mbedtls_sha256_finish(&ctx->sha, output);
+}
+
+// Like mbedtls: restart the inner hash and feed it the stored ipad block
+int mbedtls_md_hmac_reset(mbedtls_md_context_t *ctx)
+{
+    mbedtls_sha256_starts(&ctx->sha, 0);
+    return mbedtls_sha256_update(&ctx->sha, ctx->ipad, sizeof(ctx->ipad));
+}
+
+int mbedtls_md_hmac(const mbedtls_md_info_t *md_info, const unsigned char *key, size_t keylen,
+                    const unsigned char *input, size_t ilen, unsigned char *output)
+{
+    mbedtls_md_context_t ctx;
+    int ret;
+
+    mbedtls_md_init(&ctx);
+    if ((ret = mbedtls_md_setup(&ctx, md_info, 1)) == 0 &&
+        (ret = mbedtls_md_hmac_starts(&ctx, key, keylen)) == 0 &&
+        (ret = mbedtls_md_hmac_update(&ctx, input, ilen)) == 0)
+    {
+        ret = mbedtls_md_hmac_finish(&ctx, output);
+    }
+    mbedtls_md_free(&ctx);
+    return ret;
+}
@@ -0,0 +1,402 @@
+#include "http_test_server.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <esp_timer.h>
+
+#define MAX_CONNECTIONS 64
+
+typedef struct {
+    test_http_server_t *server;
+    int fd;
+    int index;
+    uint8_t buf[4096];
+    size_t pos;
+    size_t len;
+} connection_t;
+
+struct test_http_server {
+    int listen_fd;
+    int port;
+    pthread_t accept_thread;
+    pthread_mutex_t lock;
+    pthread_cond_t stopped_cond;
+    bool stopping;
+    int status;
+    unsigned delay_ms;
+    connection_t *connections[MAX_CONNECTIONS];
+    pthread_t threads[MAX_CONNECTIONS];
+    size_t num_connections;
+    test_http_request_t *requests;
+    size_t num_requests;
+    size_t cap_requests;
+};
+
+static int conn_getc(connection_t *c)
+{
+    if (c->pos >= c->len)
+    {
+        ssize_t n;
+        do
+        {
+            n = recv(c->fd, c->buf, sizeof(c->buf), 0);
+        } while (n < 0 && errno == EINTR);
+        if (n <= 0)
+        {
+            return -1;
+        }
+        c->pos = 0;
+        c->len = n;
+    }
+    return c->buf[c->pos++];
+}
+
+// One line without its CRLF; -1 on a closed connection
+static int conn_line(connection_t *c, char *line, size_t size)
+{
+    size_t len = 0;
+    int ch;
+
+    while ((ch = conn_getc(c)) >= 0 && ch != '\n')
+    {
+        if (ch != '\r' && len + 1 < size)
+        {
+            line[len++] = (char)ch;
+        }
+    }
+    line[len] = '\0';
+    return ch < 0 ? -1 : (int)len;
+}
+
+static int conn_read(connection_t *c, uint8_t *out, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        int ch = conn_getc(c);
+        if (ch < 0)
+        {
+            return -1;
+        }
+        out[i] = (uint8_t)ch;
+    }
+    return 0;
+}
+
+static void send_str(int fd, const char *s, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = send(fd, s, len, MSG_NOSIGNAL);
+        if (n <= 0)
+        {
+            return;
+        }
+        s += n;
+        len -= n;
+    }
+}
+
+const char *test_http_header(const test_http_request_t *request, const char *name, char *value, size_t size)
+{
+    size_t name_len = strlen(name);
+    const char *line = request->headers;
+
+    while (*line)
+    {
+        const char *end = strstr(line, "\r\n");
+        if (!end)
+        {
+            break;
+        }
+        if (strncasecmp(line, name, name_len) == 0 && line[name_len] == ':')
+        {
+            const char *v = line + name_len + 1;
+            while (*v == ' ')
+            {
+                v++;
+            }
+            snprintf(value, size, "%.*s", (int)(end - v), v);
+            return value;
+        }
+        line = end + 2;
+    }
+    return NULL;
+}
+
+// Read one request into req; false once the peer has gone
+static bool read_request(connection_t *c, test_http_request_t *req)
+{
+    char line[4096];
+
+    memset(req, 0, sizeof(*req));
+    if (conn_line(c, line, sizeof(line)) <= 0 ||
+        sscanf(line, "%7s %511s", req->method, req->path) != 2)
+    {
+        return false;
+    }
+    size_t hlen = 0;
+    while (conn_line(c, line, sizeof(line)) > 0)
+    {
+        hlen += snprintf(req->headers + hlen, sizeof(req->headers) - hlen, "%s\r\n", line);
+        if (hlen >= sizeof(req->headers))
+        {
+            hlen = sizeof(req->headers) - 1;
+        }
+    }
+
+    char value[64];
+    if (test_http_header(req, "Transfer-Encoding", value, sizeof(value)) && strstr(value, "chunked"))
+    {
+        for (;;)
+        {
+            if (conn_line(c, line, sizeof(line)) < 0)
+            {
+                return false;
+            }
+            size_t n = strtoul(line, NULL, 16);
+            if (n == 0)
+            {
+                while (conn_line(c, line, sizeof(line)) > 0)
+                {
+                }
+                break;
+            }
+            req->body = realloc(req->body, req->body_len + n);
+            if (conn_read(c, req->body + req->body_len, n) != 0 || conn_line(c, line, sizeof(line)) < 0)
+            {
+                return false;
+            }
+            req->body_len += n;
+        }
+    }
+    else if (test_http_header(req, "Content-Length", value, sizeof(value)))
+    {
+        req->body_len = strtoul(value, NULL, 10);
+        req->body = malloc(req->body_len ? req->body_len : 1);
+        if (conn_read(c, req->body, req->body_len) != 0)
+        {
+            return false;
+        }
+    }
+    req->connection = c->index;
+    req->received_us = esp_timer_get_time();
+    return true;
+}
+
+static void *connection_main(void *arg)
+{
+    connection_t *c = arg;
+    test_http_server_t *s = c->server;
+    test_http_request_t req;
+
+    for (;;)
+    {
+        if (!read_request(c, &req))
+        {
+            free(req.body);  // Whatever arrived of a body cut short
+            break;
+        }
+        pthread_mutex_lock(&s->lock);
+        if (s->num_requests == s->cap_requests)
+        {
+            s->cap_requests = s->cap_requests ? s->cap_requests * 2 : 16;
+            s->requests = realloc(s->requests, s->cap_requests * sizeof(*s->requests));
+        }
+        s->requests[s->num_requests++] = req;
+        int status = s->status;
+        unsigned delay_ms = s->delay_ms;
+        pthread_mutex_unlock(&s->lock);
+
+        if (strstr(req.path, "stall"))
+        {
+            pthread_mutex_lock(&s->lock);
+            while (!s->stopping)
+            {
+                pthread_cond_wait(&s->stopped_cond, &s->lock);
+            }
+            pthread_mutex_unlock(&s->lock);
+            break;
+        }
+        if (delay_ms)
+        {
+            usleep(delay_ms * 1000u);
+        }
+
+        char head[256];
+        static const char body[] = "<ok/>";
+        bool close_after = strstr(req.path, "close") || strstr(req.path, "drop");
+        if (strstr(req.path, "chunkresp"))
+        {
+            int n = snprintf(head, sizeof(head),
+                             "HTTP/1.1 403 Forbidden\r\nTransfer-Encoding: chunked\r\n\r\n%zx\r\n%s\r\n0\r\n\r\n",
+                             sizeof(body) - 1, body);
+            send_str(c->fd, head, n);
+        }
+        else
+        {
+            int n = snprintf(head, sizeof(head), "HTTP/1.1 %d Status\r\nContent-Length: %zu\r\n%s\r\n%s", status,
+                             sizeof(body) - 1, strstr(req.path, "close") ? "Connection: close\r\n" : "", body);
+            send_str(c->fd, head, n);
+        }
+        if (close_after)
+        {
+            break;
+        }
+    }
+    shutdown(c->fd, SHUT_RDWR);
+    return NULL;
+}
+
+static void *accept_main(void *arg)
+{
+    test_http_server_t *s = arg;
+
+    for (;;)
+    {
+        int fd = accept(s->listen_fd, NULL, NULL);
+        pthread_mutex_lock(&s->lock);
+        if (fd < 0 || s->stopping || s->num_connections == MAX_CONNECTIONS)
+        {
+            bool stop = fd < 0 || s->stopping;
+            pthread_mutex_unlock(&s->lock);
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+            if (stop)
+            {
+                return NULL;
+            }
+            continue;
+        }
+        connection_t *c = calloc(1, sizeof(*c));
+        c->server = s;
+        c->fd = fd;
+        c->index = (int)s->num_connections;
+        s->connections[s->num_connections] = c;
+        pthread_create(&s->threads[s->num_connections], NULL, connection_main, c);
+        s->num_connections++;
+        pthread_mutex_unlock(&s->lock);
+    }
+}
+
+test_http_server_t *test_http_server_start(void)
+{
+    test_http_server_t *s = calloc(1, sizeof(*s));
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    socklen_t addr_len = sizeof(addr);
+    int one = 1;
+
+    s->status = 200;
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->stopped_cond, NULL);
+    s->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(s->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(s->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(s->listen_fd, 16) != 0 ||
+        getsockname(s->listen_fd, (struct sockaddr *)&addr, &addr_len) != 0)
+    {
+        perror("test_http_server");
+        exit(1);
+    }
+    s->port = ntohs(addr.sin_port);
+    pthread_create(&s->accept_thread, NULL, accept_main, s);
+    return s;
+}
+
+void test_http_server_stop(test_http_server_t *s)
+{
+    pthread_mutex_lock(&s->lock);
+    s->stopping = true;
+    pthread_cond_broadcast(&s->stopped_cond);
+    pthread_mutex_unlock(&s->lock);
+
+    shutdown(s->listen_fd, SHUT_RDWR);
+    pthread_join(s->accept_thread, NULL);
+    close(s->listen_fd);
+    for (size_t i = 0; i < s->num_connections; i++)
+    {
+        shutdown(s->connections[i]->fd, SHUT_RDWR);
+        pthread_join(s->threads[i], NULL);
+        close(s->connections[i]->fd);
+        free(s->connections[i]);
+    }
+    for (size_t i = 0; i < s->num_requests; i++)
+    {
+        free(s->requests[i].body);
+    }
+    free(s->requests);
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->stopped_cond);
+    free(s);
+}
+
+int test_http_server_port(test_http_server_t *s)
+{
+    return s->port;
+}
+
+void test_http_server_set_status(test_http_server_t *s, int status)
+{
+    pthread_mutex_lock(&s->lock);
+    s->status = status;
+    pthread_mutex_unlock(&s->lock);
+}
+
+void test_http_server_set_delay_ms(test_http_server_t *s, unsigned delay_ms)
+{
+    pthread_mutex_lock(&s->lock);
+    s->delay_ms = delay_ms;
+    pthread_mutex_unlock(&s->lock);
+}
+
+size_t test_http_server_request_count(test_http_server_t *s)
+{
+    pthread_mutex_lock(&s->lock);
+    size_t n = s->num_requests;
+    pthread_mutex_unlock(&s->lock);
+    return n;
+}
+
+size_t test_http_server_connection_count(test_http_server_t *s)
+{
+    pthread_mutex_lock(&s->lock);
+    size_t n = s->num_connections;
+    pthread_mutex_unlock(&s->lock);
+    return n;
+}
+
+int test_http_server_get_request(test_http_server_t *s, size_t i, test_http_request_t *out)
+{
+    pthread_mutex_lock(&s->lock);
+    if (i >= s->num_requests)
+    {
+        pthread_mutex_unlock(&s->lock);
+        return -1;
+    }
+    *out = s->requests[i];
+    out->body = malloc(out->body_len ? out->body_len : 1);
+    if (out->body_len)
+    {
+        memcpy(out->body, s->requests[i].body, out->body_len);
+    }
+    pthread_mutex_unlock(&s->lock);
+    return 0;
+}
+
+void test_http_request_free(test_http_request_t *request)
+{
+    free(request->body);
+    request->body = NULL;
+}
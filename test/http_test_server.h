@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Local HTTP/1.1 server standing in for S3 in the host tests. It listens on
+// an ephemeral loopback port, accepts PUT and GET with Content-Length or
+// chunked bodies and keeps connections alive. Every request is recorded.
+//
+// The path picks the reply, so a test can script a server's behaviour per
+// request:
+//   .../close...      answers with "Connection: close" and closes
+//   .../drop...       answers normally, then closes without saying so
+//   .../chunkresp...  answers 403 with a chunked body
+//   .../stall...      reads the request and never answers
+
+typedef struct {
+    char method[8];
+    char path[512];
+    char headers[2048];     // Raw header block, one "Name: value\r\n" per line
+    uint8_t *body;
+    size_t body_len;
+    int connection;         // Index of the connection it arrived on, from 0
+    int64_t received_us;    // esp_timer time the body was complete
+} test_http_request_t;
+
+typedef struct test_http_server test_http_server_t;
+
+test_http_server_t *test_http_server_start(void);
+
+// Stops accepting, closes every connection and frees all recorded requests
+void test_http_server_stop(test_http_server_t *server);
+
+int test_http_server_port(test_http_server_t *server);
+
+// Status of ordinary replies, 200 by default
+void test_http_server_set_status(test_http_server_t *server, int status);
+
+// Delay every reply by this many milliseconds, to stand in for a slow link
+void test_http_server_set_delay_ms(test_http_server_t *server, unsigned delay_ms);
+
+size_t test_http_server_request_count(test_http_server_t *server);
+
+size_t test_http_server_connection_count(test_http_server_t *server);
+
+// Copy of request i (body included, caller frees it with test_http_request_free)
+int test_http_server_get_request(test_http_server_t *server, size_t i, test_http_request_t *out_request);
+
+void test_http_request_free(test_http_request_t *request);
+
+// Value of a header of a recorded request, case-insensitive; NULL if absent
+const char *test_http_header(const test_http_request_t *request, const char *name, char *value, size_t size);
@@ -0,0 +1,341 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <string.h>
+#include "capture_pipeline.h"
+#include "test_util.h"
+
+// Throughput and backpressure of the capture pipeline with a synthetic source
+// and uploader. The source stamps every payload with a pattern derived from a
+// counter, so the uploader can tell a torn or reused slot from a good frame.
+
+#define FRAME_BYTES 4096
+
+typedef struct {
+    atomic_uint limit;          // Frames to produce before the stage starts skipping
+    atomic_uint produced;
+} mock_source_t;
+
+typedef struct {
+    unsigned delay_ms;          // Simulated time on the wire per frame
+    atomic_uint uploaded;
+    atomic_uint corrupt;
+    atomic_uint out_of_order;
+    uint32_t last_seq;
+    bool started;
+    esp_err_t result;
+} mock_uploader_t;
+
+static esp_err_t mock_capture(void *ctx, pipeline_frame_t *frame)
+{
+    mock_source_t *src = ctx;
+    uint32_t n = atomic_fetch_add(&src->produced, 1);
+
+    for (size_t i = 0; i < FRAME_BYTES; i++)
+    {
+        frame->buf[i] = (uint8_t)(n * 31 + i);
+    }
+    memcpy(frame->buf, &n, sizeof(n));
+    frame->len = FRAME_BYTES;
+    frame->width = 64;
+    frame->height = 32;
+    frame->format = FRAME_FORMAT_RGB565;
+    return ESP_OK;
+}
+
+// Lets the first `limit` frames through, then drains the pipeline
+static esp_err_t limit_stage(void *ctx, pipeline_frame_t *frame)
+{
+    mock_source_t *src = ctx;
+    uint32_t n;
+
+    memcpy(&n, frame->buf, sizeof(n));
+    return n < atomic_load(&src->limit) ? ESP_OK : FRAME_STAGE_SKIP;
+}
+
+static esp_err_t mock_upload(void *ctx, const pipeline_frame_t *frame)
+{
+    mock_uploader_t *up = ctx;
+    uint32_t n;
+
+    memcpy(&n, frame->buf, sizeof(n));
+    for (size_t i = sizeof(n); i < frame->len; i++)
+    {
+        if (frame->buf[i] != (uint8_t)(n * 31 + i))
+        {
+            atomic_fetch_add(&up->corrupt, 1);
+            break;
+        }
+    }
+    if (up->started && (int32_t)(frame->seq - up->last_seq) <= 0)
+    {
+        atomic_fetch_add(&up->out_of_order, 1);
+    }
+    up->started = true;
+    up->last_seq = frame->seq;
+    if (up->delay_ms)
+    {
+        test_sleep_ms(up->delay_ms);
+    }
+    if (up->result == ESP_OK)
+    {
+        atomic_fetch_add(&up->uploaded, 1);
+    }
+    return up->result;
+}
+
+static capture_pipeline_config_t make_config(mock_source_t *src, mock_uploader_t *up)
+{
+    return (capture_pipeline_config_t){
+        .source = { .capture = mock_capture, .ctx = src },
+        .stages = { { .process = limit_stage, .ctx = src } },
+        .num_stages = 1,
+        .uploader = { .upload = mock_upload, .ctx = up },
+        .queue_len = 3,
+        .frame_capacity = FRAME_BYTES,
+        .task_stack_size = 4096,
+        .task_priority = 5,
+    };
+}
+
+// Every queued frame ends up uploaded, failed, deferred or dropped once the source stops
+static bool drained(capture_pipeline_handle_t p, uint32_t limit)
+{
+    capture_pipeline_stats_t s;
+
+    capture_pipeline_get_stats(p, &s);
+    return s.captured == limit && s.queued == 0 &&
+           s.uploaded + s.upload_errors + s.deferred + s.dropped == s.captured;
+}
+
+// Raw pipeline overhead with a free-running source. The source outruns even
+// an instant uploader, so frames are dropped, but every one is accounted for.
+static void test_throughput(void)
+{
+    const uint32_t frames = 2000;
+    mock_source_t src = { .limit = frames };
+    mock_uploader_t up = {0};
+    capture_pipeline_config_t cfg = make_config(&src, &up);
+    capture_pipeline_handle_t p;
+
+    double start = test_now_s();
+    CHECK_EQ(capture_pipeline_start(&cfg, &p), ESP_OK);
+    CHECK(WAIT_FOR(drained(p, frames), 20000));
+    double elapsed = test_now_s() - start;
+
+    capture_pipeline_stats_t s;
+    capture_pipeline_get_stats(p, &s);
+    CHECK_EQ(capture_pipeline_stop(p), ESP_OK);
+
+    printf("%u frames in %.3f s: %.0f frames/s, %.1f MB/s, %u dropped\n", frames, elapsed, frames / elapsed,
+           frames * (double)FRAME_BYTES / elapsed / 1e6, s.dropped);
+    CHECK_EQ(s.uploaded + s.dropped, frames);
+    CHECK_EQ(s.upload_errors, 0);
+    CHECK_EQ(s.capture_errors, 0);
+    CHECK_EQ(s.stage_errors, 0);
+    CHECK_EQ(atomic_load(&up.corrupt), 0);
+    CHECK_EQ(atomic_load(&up.out_of_order), 0);
+    CHECK_EQ(atomic_load(&up.uploaded), s.uploaded);
+}
+
+// An uploader that keeps up with the capture interval never loses a frame
+static void test_paced_no_drops(void)
+{
+    const uint32_t frames = 300;
+    mock_source_t src = { .limit = frames };
+    mock_uploader_t up = {0};
+    capture_pipeline_config_t cfg = make_config(&src, &up);
+    cfg.queue_len = 16;  // Slack for host scheduling hiccups
+    cfg.capture_interval_ms = 2;
+    capture_pipeline_handle_t p;
+
+    CHECK_EQ(capture_pipeline_start(&cfg, &p), ESP_OK);
+    CHECK(WAIT_FOR(drained(p, frames), 10000));
+    capture_pipeline_stats_t s;
+    capture_pipeline_get_stats(p, &s);
+    CHECK_EQ(capture_pipeline_stop(p), ESP_OK);
+
+    CHECK_EQ(s.dropped, 0);
+    CHECK_EQ(s.uploaded, frames);
+    CHECK_EQ(atomic_load(&up.corrupt), 0);
+    CHECK_EQ(atomic_load(&up.out_of_order), 0);
+}
+
+// A slow uploader never stalls capture: the oldest queued frames are dropped,
+// the backlog stays within queue_len and the uploader sees frames in order
+static void test_backpressure(void)
+{
+    const uint32_t frames = 400;
+    mock_source_t src = { .limit = frames };
+    mock_uploader_t up = { .delay_ms = 20 };
+    capture_pipeline_config_t cfg = make_config(&src, &up);
+    cfg.capture_interval_ms = 2;
+    capture_pipeline_handle_t p;
+    uint32_t max_queued = 0;
+
+    double start = test_now_s();
+    CHECK_EQ(capture_pipeline_start(&cfg, &p), ESP_OK);
+    capture_pipeline_stats_t s;
+    do
+    {
+        capture_pipeline_get_stats(p, &s);
+        max_queued = s.queued > max_queued ? s.queued : max_queued;
+        test_sleep_ms(1);
+    } while (s.captured < frames && test_now_s() - start < 20);
+    double capture_time = test_now_s() - start;
+    CHECK(WAIT_FOR(drained(p, frames), 5000));
+    capture_pipeline_get_stats(p, &s);
+    CHECK_EQ(capture_pipeline_stop(p), ESP_OK);
+
+    printf("captured %u in %.3f s, uploaded %u, dropped %u, max queued %u\n", s.captured, capture_time,
+           s.uploaded, s.dropped, max_queued);
+    // Had capture waited on the 20 ms uploads nothing would have been dropped;
+    // the timing above is only printed, a loaded host can stretch it either way
+    CHECK(s.dropped > frames / 2);
+    CHECK(max_queued <= cfg.queue_len - 1);
+    CHECK_EQ(s.uploaded + s.dropped, frames);
+    CHECK_EQ(atomic_load(&up.corrupt), 0);
+    CHECK_EQ(atomic_load(&up.out_of_order), 0);
+}
+
+static esp_err_t failing_stage(void *ctx, pipeline_frame_t *frame)
+{
+    mock_source_t *src = ctx;
+    uint32_t n;
+
+    memcpy(&n, frame->buf, sizeof(n));
+    if (n >= atomic_load(&src->limit))
+    {
+        return FRAME_STAGE_SKIP;
+    }
+    // Any ESP-IDF error, including ESP_ERR_NOT_FINISHED, is a failure and not a skip
+    return n % 2 ? ESP_ERR_NOT_FINISHED : ESP_OK;
+}
+
+// Skips and stage failures are told apart, and failed uploads are counted
+static void test_skip_and_errors(void)
+{
+    const uint32_t frames = 100;
+    mock_source_t src = { .limit = frames };
+    mock_uploader_t up = { .result = ESP_ERR_TIMEOUT };
+    capture_pipeline_config_t cfg = make_config(&src, &up);
+    cfg.stages[0] = (frame_stage_t){ .process = failing_stage, .ctx = &src };
+    cfg.queue_len = 8;
+    cfg.capture_interval_ms = 1;
+    capture_pipeline_handle_t p;
+
+    CHECK(FRAME_STAGE_SKIP != ESP_ERR_NOT_FINISHED);
+    CHECK_EQ(capture_pipeline_start(&cfg, &p), ESP_OK);
+    capture_pipeline_stats_t s;
+    CHECK(WAIT_FOR((capture_pipeline_get_stats(p, &s), s.skipped > 10 && s.queued == 0 &&
+                    s.upload_errors + s.dropped == s.captured), 5000));
+    CHECK_EQ(capture_pipeline_stop(p), ESP_OK);
+
+    CHECK_EQ(s.captured, frames / 2);
+    CHECK_EQ(s.stage_errors, frames / 2);
+    CHECK_EQ(s.uploaded, 0);
+    CHECK_EQ(s.upload_errors + s.dropped, frames / 2);
+}
+
+// Frames the uploader keeps for later are neither uploads nor failures
+static void test_deferred(void)
+{
+    const uint32_t frames = 50;
+    mock_source_t src = { .limit = frames };
+    mock_uploader_t up = { .result = FRAME_UPLOAD_DEFERRED };
+    capture_pipeline_config_t cfg = make_config(&src, &up);
+    cfg.queue_len = 8;
+    cfg.capture_interval_ms = 1;
+    capture_pipeline_handle_t p;
+
+    CHECK_EQ(capture_pipeline_start(&cfg, &p), ESP_OK);
+    CHECK(WAIT_FOR(drained(p, frames), 5000));
+    capture_pipeline_stats_t s;
+    capture_pipeline_get_stats(p, &s);
+    CHECK_EQ(capture_pipeline_stop(p), ESP_OK);
+
+    CHECK_EQ(s.deferred + s.dropped, frames);
+    CHECK(s.deferred > 0);
+    CHECK_EQ(s.uploaded, 0);
+    CHECK_EQ(s.upload_errors, 0);
+}
+
+typedef struct {
+    atomic_uint published;
+    atomic_uint encoded;        // Frames the stage after the tap-only one saw
+} mock_tap_t;
+
+// Keeps odd frames from upload but not from the tap
+static esp_err_t tap_only_stage(void *ctx, pipeline_frame_t *frame)
+{
+    uint32_t n;
+
+    memcpy(&n, frame->buf, sizeof(n));
+    return n % 2 ? FRAME_STAGE_TAP_ONLY : ESP_OK;
+}
+
+static esp_err_t counting_stage(void *ctx, pipeline_frame_t *frame)
+{
+    mock_tap_t *tap = ctx;
+
+    atomic_fetch_add(&tap->encoded, 1);
+    return ESP_OK;
+}
+
+static void mock_publish(void *ctx, capture_pipeline_handle_t pipeline, const pipeline_frame_t *frame)
+{
+    mock_tap_t *tap = ctx;
+
+    atomic_fetch_add(&tap->published, 1);
+}
+
+// Frames a stage keeps from upload still run the later stages and reach the
+// tap, and their slots come back; without a tap they are plain skips
+static void test_tap_only(void)
+{
+    const uint32_t frames = 40;
+
+    for (int with_tap = 1; with_tap >= 0; with_tap--)
+    {
+        mock_source_t src = { .limit = frames };
+        mock_uploader_t up = { .result = ESP_OK };
+        mock_tap_t tap = {0};
+        capture_pipeline_config_t cfg = make_config(&src, &up);
+        cfg.stages[1] = (frame_stage_t){ .process = tap_only_stage };
+        cfg.stages[2] = (frame_stage_t){ .process = counting_stage, .ctx = &tap };
+        cfg.num_stages = 3;
+        cfg.queue_len = 8;
+        cfg.capture_interval_ms = 1;
+        if (with_tap)
+        {
+            cfg.tap = (frame_tap_t){ .publish = mock_publish, .ctx = &tap };
+            cfg.tap_slots = 1;
+        }
+        capture_pipeline_handle_t p;
+
+        CHECK_EQ(capture_pipeline_start(&cfg, &p), ESP_OK);
+        CHECK(WAIT_FOR(drained(p, frames / 2) && atomic_load(&src.produced) > frames, 5000));
+        capture_pipeline_stats_t s;
+        capture_pipeline_get_stats(p, &s);
+        CHECK_EQ(capture_pipeline_stop(p), ESP_OK);
+
+        printf("%s tap: published %u, uploaded %u, dropped %u, skipped %u\n", with_tap ? "with" : "without",
+               atomic_load(&tap.published), s.uploaded, s.dropped, s.skipped);
+        CHECK_EQ(s.uploaded + s.dropped, frames / 2);
+        CHECK_EQ(atomic_load(&up.corrupt), 0);
+        CHECK(s.skipped >= frames / 2);
+        CHECK_EQ(atomic_load(&tap.published), with_tap ? frames : 0);
+        CHECK_EQ(atomic_load(&tap.encoded), with_tap ? frames : frames / 2);
+    }
+}
+
+int main(void)
+{
+    RUN_TEST(test_throughput);
+    RUN_TEST(test_paced_no_drops);
+    RUN_TEST(test_backpressure);
+    RUN_TEST(test_skip_and_errors);
+    RUN_TEST(test_deferred);
+    RUN_TEST(test_tap_only);
+    printf("All capture pipeline tests passed\n");
+    return 0;
+}
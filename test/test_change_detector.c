@@ -0,0 +1,231 @@
+#include <stdlib.h>
+#include <string.h>
+#include "change_detector.h"
+#include "test_util.h"
+
+// Synthetic sequences for the change detector: a static scene with sensor
+// noise, a moving object, a global lighting step, a resolution change and the
+// forced keyframe after max_skipped_frames, plus the analysis rate at VGA
+
+typedef struct {
+    int box_x, box_y;   // Top-left of a 30x30 white square, -1 for none
+    int noise;          // Peak +/- noise added to every pixel's blue channel
+    int brightness;     // Added to every channel's top bits, for lighting changes
+} scene_t;
+
+static uint32_t s_rng = 1;
+
+static int rnd(int range)
+{
+    s_rng = s_rng * 1103515245 + 12345;
+    return (int)((s_rng >> 16) % (2 * range + 1)) - range;
+}
+
+static int clamp(int v, int max)
+{
+    return v < 0 ? 0 : v > max ? max : v;
+}
+
+static void draw(uint8_t *buf, int w, int h, const scene_t *s)
+{
+    for (int y = 0; y < h; y++)
+    {
+        for (int x = 0; x < w; x++)
+        {
+            int r = clamp(x * 31 / w + s->brightness, 31);
+            int g = clamp(y * 63 / h + s->brightness * 2, 63);
+            int b = clamp(10 + s->brightness + (s->noise ? rnd(s->noise) : 0), 31);
+            if (s->box_x >= 0 && x >= s->box_x && x < s->box_x + 30 && y >= s->box_y && y < s->box_y + 30)
+            {
+                r = 31, g = 63, b = 31;
+            }
+            uint16_t p = (uint16_t)(r << 11 | g << 5 | b);
+            buf[(y * w + x) * 2] = p >> 8;
+            buf[(y * w + x) * 2 + 1] = p & 0xff;
+        }
+    }
+}
+
+static change_detector_handle_t make_detector(uint32_t max_skipped)
+{
+    change_detector_config_t cfg = {
+        .thumb_scale = 2,
+        .pixel_threshold = 8,
+        .min_changed_tiles = 1,
+        .max_skipped_frames = max_skipped,
+    };
+    change_detector_handle_t det;
+
+    CHECK_EQ(change_detector_create(&cfg, 640, 480, &det), ESP_OK);
+    return det;
+}
+
+static change_result_t process(change_detector_handle_t det, uint8_t *buf, int w, int h, const scene_t *s)
+{
+    change_result_t r;
+
+    draw(buf, w, h, s);
+    CHECK_EQ(change_detector_process(det, buf, w, h, &r), ESP_OK);
+    return r;
+}
+
+// Sensor noise on a static scene is never mistaken for change
+static void test_static_noise(void)
+{
+    const int w = 160, h = 120;
+    uint8_t *buf = malloc(w * h * 2);
+    change_detector_handle_t det = make_detector(0);
+    scene_t s = { .box_x = 40, .box_y = 40, .noise = 0 };
+
+    change_result_t r = process(det, buf, w, h, &s);
+    CHECK(r.forward);  // First frame
+    CHECK(r.total_tiles > 0);
+    s.noise = 2;
+    for (int i = 0; i < 50; i++)
+    {
+        r = process(det, buf, w, h, &s);
+        CHECK(!r.forward);
+        CHECK_EQ(r.changed_tiles, 0);
+    }
+    change_detector_delete(det);
+    free(buf);
+}
+
+// A moving object is forwarded, a stopped one is not, and a small move is
+// measured against the last forwarded frame rather than the previous one
+static void test_moving_object(void)
+{
+    const int w = 160, h = 120;
+    uint8_t *buf = malloc(w * h * 2);
+    change_detector_handle_t det = make_detector(0);
+    scene_t s = { .box_x = 10, .box_y = 10, .noise = 1 };
+
+    CHECK(process(det, buf, w, h, &s).forward);
+    s.box_x = 60, s.box_y = 50;
+    change_result_t r = process(det, buf, w, h, &s);
+    CHECK(r.forward);
+    CHECK(r.changed_tiles >= 2);  // Where the box left and where it arrived
+    CHECK(!process(det, buf, w, h, &s).forward);
+
+    // Creep one pixel at a time: each step alone is too small, but the drift
+    // from the reference eventually is
+    int forwarded_at = -1;
+    for (int i = 1; i <= 30 && forwarded_at < 0; i++)
+    {
+        s.box_x = 60 + i;
+        if (process(det, buf, w, h, &s).forward)
+        {
+            forwarded_at = i;
+        }
+    }
+    printf("1 px/frame drift forwarded after %d frames\n", forwarded_at);
+    CHECK(forwarded_at > 1 && forwarded_at <= 30);
+
+    change_detector_delete(det);
+    free(buf);
+}
+
+// A lighting change across the whole frame changes every tile
+static void test_lighting_step(void)
+{
+    const int w = 160, h = 120;
+    uint8_t *buf = malloc(w * h * 2);
+    change_detector_handle_t det = make_detector(0);
+    scene_t s = { .box_x = -1 };
+
+    change_result_t r = process(det, buf, w, h, &s);
+    s.brightness = 6;
+    r = process(det, buf, w, h, &s);
+    CHECK(r.forward);
+    CHECK(r.changed_tiles > r.total_tiles / 2);
+
+    change_detector_delete(det);
+    free(buf);
+}
+
+// A new resolution has no comparable reference, and neither has a reset
+static void test_resolution_change_and_reset(void)
+{
+    uint8_t *buf = malloc(640 * 480 * 2);
+    change_detector_handle_t det = make_detector(0);
+    scene_t s = { .box_x = -1 };
+
+    CHECK(process(det, buf, 160, 120, &s).forward);
+    CHECK(!process(det, buf, 160, 120, &s).forward);
+    change_result_t r = process(det, buf, 320, 240, &s);
+    CHECK(r.forward);
+    CHECK(!process(det, buf, 320, 240, &s).forward);
+    change_detector_reset(det);
+    CHECK(process(det, buf, 320, 240, &s).forward);
+
+    // Larger than the detector was created for; rejected before the buffer is read
+    CHECK_EQ(change_detector_process(det, buf, 1280, 480, &r), ESP_ERR_INVALID_SIZE);
+
+    change_detector_delete(det);
+    free(buf);
+}
+
+// An unchanging scene still gets a keyframe after max_skipped_frames skips
+static void test_max_skipped(void)
+{
+    const int w = 160, h = 120;
+    uint8_t *buf = malloc(w * h * 2);
+    change_detector_handle_t det = make_detector(5);
+    scene_t s = { .box_x = 20, .box_y = 20 };
+    int forwarded = 0;
+
+    for (int i = 0; i < 25; i++)
+    {
+        change_result_t r = process(det, buf, w, h, &s);
+        if (r.forward)
+        {
+            forwarded++;
+            // Frames 0, 6, 12, 18, 24
+            CHECK_EQ(i % 6, 0);
+        }
+    }
+    CHECK_EQ(forwarded, 5);
+
+    change_detector_delete(det);
+    free(buf);
+}
+
+static void test_throughput(void)
+{
+    const int w = 640, h = 480;
+    uint8_t *buf = malloc(w * h * 2);
+    change_detector_config_t cfg = {
+        .thumb_scale = 4,
+        .pixel_threshold = 8,
+        .min_changed_tiles = 1,
+    };
+    change_detector_handle_t det;
+    scene_t s = { .box_x = 100, .box_y = 100, .noise = 1 };
+    change_result_t r;
+
+    CHECK_EQ(change_detector_create(&cfg, w, h, &det), ESP_OK);
+    draw(buf, w, h, &s);
+    const int runs = 300;
+    double start = test_now_s();
+    for (int i = 0; i < runs; i++)
+    {
+        CHECK_EQ(change_detector_process(det, buf, w, h, &r), ESP_OK);
+    }
+    double elapsed = test_now_s() - start;
+    printf("VGA analysis: %.0f frames/s, %.0f MB/s\n", runs / elapsed, runs * (double)w * h * 2 / elapsed / 1e6);
+
+    change_detector_delete(det);
+    free(buf);
+}
+
+int main(void)
+{
+    RUN_TEST(test_static_noise);
+    RUN_TEST(test_moving_object);
+    RUN_TEST(test_lighting_step);
+    RUN_TEST(test_resolution_change_and_reset);
+    RUN_TEST(test_max_skipped);
+    RUN_TEST(test_throughput);
+    printf("All change detector tests passed\n");
+    return 0;
+}
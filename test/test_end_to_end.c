@@ -0,0 +1,251 @@
+#include <stdatomic.h>
+#include <string.h>
+#include "capture_pipeline.h"
+#include "http_uploader.h"
+#include "jpeg_encoder.h"
+#include "metrics.h"
+#include "http_test_server.h"
+#include "test_util.h"
+
+// The whole upload path on the host: a fake camera feeds the capture
+// pipeline, frames are JPEG-encoded on the capture task and PUT to a local
+// stand-in server over one kept-alive connection. Reports frames/s and the
+// per-stage latency the firmware would log, and checks the stages add up.
+
+#define WIDTH  320
+#define HEIGHT 240
+#define SLOT_SIZE (WIDTH * HEIGHT * 2)
+
+typedef struct {
+    atomic_uint produced;
+    uint32_t last;                  // Number of the frame just captured
+    uint32_t limit;                 // Frames let through before the pipeline drains
+} fake_camera_t;
+
+typedef struct {
+    jpeg_encoder_handle_t encoder;
+    uint8_t *spare;
+} encode_stage_t;
+
+typedef struct {
+    http_uploader_handle_t http;
+    int port;
+    atomic_uint rejected;
+} test_uploader_t;
+
+// A gradient with a bar sweeping across it, big-endian RGB565 like the sensor
+static esp_err_t fake_camera_capture(void *ctx, pipeline_frame_t *frame)
+{
+    fake_camera_t *cam = ctx;
+    int64_t start = metrics_now();
+    uint32_t n = atomic_fetch_add(&cam->produced, 1);
+    cam->last = n;
+    int bar = (n * 7) % WIDTH;
+
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        for (int x = 0; x < WIDTH; x++)
+        {
+            uint16_t p = x >= bar && x < bar + 12 ? 0xffff :
+                         (uint16_t)((x * 31 / WIDTH) << 11 | (y * 63 / HEIGHT) << 5 | ((x + y + n) & 31));
+            frame->buf[(y * WIDTH + x) * 2] = p >> 8;
+            frame->buf[(y * WIDTH + x) * 2 + 1] = p & 0xff;
+        }
+    }
+    frame->len = SLOT_SIZE;
+    frame->width = WIDTH;
+    frame->height = HEIGHT;
+    frame->format = FRAME_FORMAT_RGB565;
+    metrics_since(METRIC_FB_GET, start);
+    return ESP_OK;
+}
+
+static esp_err_t limit_stage(void *ctx, pipeline_frame_t *frame)
+{
+    fake_camera_t *cam = ctx;
+
+    // Runs on the capture task right after the capture, so `last` is this frame
+    return cam->last < cam->limit ? ESP_OK : FRAME_STAGE_SKIP;
+}
+
+// Same as the firmware's encode stage: encode into the spare buffer and swap
+static esp_err_t encode_stage(void *ctx, pipeline_frame_t *frame)
+{
+    encode_stage_t *stage = ctx;
+    size_t len;
+
+    int64_t start = metrics_now();
+    esp_err_t err = jpeg_encoder_encode(stage->encoder, frame->buf, frame->width, frame->height, stage->spare,
+                                        frame->capacity, &len);
+    if (err != ESP_OK)
+    {
+        metrics_record_error(METRIC_ENCODE);
+        return err;
+    }
+    metrics_since(METRIC_ENCODE, start);
+
+    uint8_t *raw = frame->buf;
+    frame->buf = stage->spare;
+    stage->spare = raw;
+    frame->len = len;
+    frame->format = FRAME_FORMAT_JPEG;
+    return ESP_OK;
+}
+
+static esp_err_t test_upload(void *ctx, const pipeline_frame_t *frame)
+{
+    test_uploader_t *up = ctx;
+    char url[96];
+    int status = 0;
+
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/frames/%06u.jpg", up->port, (unsigned)frame->seq);
+    esp_err_t err = http_uploader_put(up->http, url, "image/jpeg", NULL, frame->buf, frame->len, &status);
+    if (err == ESP_OK && status != 200)
+    {
+        atomic_fetch_add(&up->rejected, 1);
+        err = ESP_FAIL;
+    }
+    return err;
+}
+
+static void print_stages(void)
+{
+    printf("%-10s %6s %4s %9s %9s %9s\n", "stage", "n", "err", "p50_us", "p99_us", "max_us");
+    for (int i = 0; i < METRIC_COUNT; i++)
+    {
+        metrics_summary_t s;
+        metrics_get_summary(i, &s);
+        if (s.count || s.errors)
+        {
+            printf("%-10s %6u %4u %9u %9u %9u\n", metrics_stage_name(i), s.count, s.errors, s.p50_us, s.p99_us,
+                   s.max_us);
+        }
+    }
+}
+
+static uint32_t stage_count(metric_stage_t stage)
+{
+    metrics_summary_t s;
+    metrics_get_summary(stage, &s);
+    return s.count;
+}
+
+// Exact, unlike the percentiles, which are interpolated within a bucket
+static uint64_t stage_mean(metric_stage_t stage)
+{
+    metrics_summary_t s;
+    metrics_get_summary(stage, &s);
+    return s.count ? s.total_us / s.count : 0;
+}
+
+// Run `frames` frames through the full path against a server that delays
+// each reply by reply_delay_ms; returns the pipeline counters
+static capture_pipeline_stats_t run(uint32_t frames, uint32_t interval_ms, unsigned reply_delay_ms,
+                                    test_http_server_t **out_server)
+{
+    test_http_server_t *server = test_http_server_start();
+    fake_camera_t cam = { .limit = frames };
+    encode_stage_t enc = { .spare = capture_pipeline_alloc_buffer(SLOT_SIZE) };
+    test_uploader_t up = { .port = test_http_server_port(server) };
+    http_uploader_config_t http_cfg = {
+        .chunk_size = 4096,
+        .timeout_ms = 5000,
+        .idle_timeout_ms = 10000,
+    };
+
+    test_http_server_set_delay_ms(server, reply_delay_ms);
+    CHECK_EQ(jpeg_encoder_create(WIDTH, HEIGHT, 80, &enc.encoder), ESP_OK);
+    CHECK_EQ(http_uploader_create(&http_cfg, &up.http), ESP_OK);
+    metrics_reset();
+
+    capture_pipeline_config_t cfg = {
+        .source = { .capture = fake_camera_capture, .ctx = &cam },
+        .stages = {
+            { .process = limit_stage, .ctx = &cam },
+            { .process = encode_stage, .ctx = &enc },
+        },
+        .num_stages = 2,
+        .uploader = { .upload = test_upload, .ctx = &up },
+        .queue_len = 4,
+        .frame_capacity = SLOT_SIZE,
+        .capture_interval_ms = interval_ms,
+        .task_stack_size = 16384,
+        .task_priority = 5,
+    };
+    capture_pipeline_handle_t p;
+    capture_pipeline_stats_t s;
+
+    double start = test_now_s();
+    CHECK_EQ(capture_pipeline_start(&cfg, &p), ESP_OK);
+    CHECK(WAIT_FOR((capture_pipeline_get_stats(p, &s), s.captured == frames && s.queued == 0 &&
+                    s.uploaded + s.upload_errors + s.dropped == frames), 60000));
+    double elapsed = test_now_s() - start;
+    CHECK_EQ(capture_pipeline_stop(p), ESP_OK);
+
+    http_uploader_stats_t hs;
+    http_uploader_get_stats(up.http, &hs);
+    printf("%u frames in %.2f s: %.1f frames/s uploaded, %u dropped, %.2f MB/s on the wire, %u connection(s)\n",
+           frames, elapsed, s.uploaded / elapsed, s.dropped, hs.bytes_sent / elapsed / 1e6, hs.connections);
+    print_stages();
+
+    CHECK_EQ(s.upload_errors, 0);
+    CHECK_EQ(atomic_load(&up.rejected), 0);
+    CHECK_EQ(hs.connections, 1);
+    CHECK_EQ(test_http_server_request_count(server), s.uploaded);
+
+    http_uploader_delete(up.http);
+    jpeg_encoder_delete(enc.encoder);
+    free(enc.spare);
+    *out_server = server;
+    return s;
+}
+
+// Every frame that arrives is an intact JPEG, and the stage counters agree
+// with the pipeline and the server
+static void test_fast_link(void)
+{
+    test_http_server_t *server;
+    const uint32_t frames = 200;
+    capture_pipeline_stats_t s = run(frames, 0, 0, &server);
+
+    for (size_t i = 0; i < test_http_server_request_count(server); i++)
+    {
+        test_http_request_t req;
+        CHECK_EQ(test_http_server_get_request(server, i, &req), 0);
+        CHECK(req.body_len > 100);
+        CHECK(req.body[0] == 0xff && req.body[1] == 0xd8);
+        CHECK(req.body[req.body_len - 2] == 0xff && req.body[req.body_len - 1] == 0xd9);
+        test_http_request_free(&req);
+    }
+    CHECK_EQ(stage_count(METRIC_ENCODE), frames);
+    CHECK(stage_count(METRIC_FB_GET) >= frames);
+    CHECK_EQ(stage_count(METRIC_CONNECT), 1);
+    CHECK_EQ(stage_count(METRIC_SEND), s.uploaded);
+    CHECK_EQ(stage_count(METRIC_RESPONSE), s.uploaded);
+    CHECK_EQ(stage_count(METRIC_FRAME), s.uploaded);
+    test_http_server_stop(server);
+}
+
+// A slow server shows up as response time and in every frame's latency, and
+// the frames that cannot keep up are dropped rather than stalling capture
+static void test_slow_server(void)
+{
+    test_http_server_t *server;
+    const unsigned delay_ms = 25;
+    capture_pipeline_stats_t s = run(100, 5, delay_ms, &server);
+
+    // Only lower bounds, which the server's delay guarantees; the send time is
+    // printed above but not bounded, as a loaded host can stretch any of them
+    CHECK(stage_mean(METRIC_RESPONSE) >= delay_ms * 1000);
+    CHECK(stage_mean(METRIC_FRAME) >= delay_ms * 1000);
+    CHECK(s.dropped > 0);
+    test_http_server_stop(server);
+}
+
+int main(void)
+{
+    RUN_TEST(test_fast_link);
+    RUN_TEST(test_slow_server);
+    printf("All end-to-end tests passed\n");
+    return 0;
+}
@@ -0,0 +1,204 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <string.h>
+#include "capture_pipeline.h"
+#include "frame_fanout.h"
+#include "test_util.h"
+
+// Fairness of the frame fan-out: the capture pipeline publishes to a fast
+// viewer, a slow viewer and a viewer stuck holding a frame, while the
+// uploader keeps taking frames off the queue. No viewer may slow down capture,
+// the uploader or another viewer, and no slot may be reused while held.
+
+#define FRAME_BYTES  4096
+#define INTERVAL_MS  10
+#define UPLOAD_MS    20
+#define RUN_MS       2000
+
+typedef struct {
+    uint32_t produced;
+    int64_t last_us;
+    int64_t max_gap_us;         // Longest time between two captures
+} source_t;
+
+typedef struct {
+    const char *name;
+    unsigned work_ms;           // Time spent on each frame, like sending it
+    bool stuck;                 // Keeps the first frame until the run ends
+    frame_fanout_reader_t reader;
+} viewer_t;
+
+static frame_fanout_handle_t s_fanout;
+static atomic_bool s_stop;
+static atomic_uint s_corrupt;
+static atomic_uint s_max_held;
+
+static esp_err_t source_capture(void *ctx, pipeline_frame_t *frame)
+{
+    source_t *src = ctx;
+    uint32_t n = src->produced++;
+    int64_t now = (int64_t)(test_now_s() * 1e6);
+
+    if (src->last_us && now - src->last_us > src->max_gap_us)
+    {
+        src->max_gap_us = now - src->last_us;
+    }
+    src->last_us = now;
+    for (size_t i = 0; i < FRAME_BYTES; i++)
+    {
+        frame->buf[i] = (uint8_t)(n * 31 + i);
+    }
+    memcpy(frame->buf, &n, sizeof(n));
+    frame->len = FRAME_BYTES;
+    frame->format = FRAME_FORMAT_JPEG;
+    return ESP_OK;
+}
+
+// The payload is still the one captured for this frame's sequence number
+static bool frame_intact(const pipeline_frame_t *frame)
+{
+    uint32_t n;
+
+    memcpy(&n, frame->buf, sizeof(n));
+    return n == frame->seq && frame->buf[FRAME_BYTES - 1] == (uint8_t)(n * 31 + FRAME_BYTES - 1);
+}
+
+static esp_err_t slow_upload(void *ctx, const pipeline_frame_t *frame)
+{
+    test_sleep_ms(UPLOAD_MS);
+    if (!frame_intact(frame))
+    {
+        atomic_fetch_add(&s_corrupt, 1);
+    }
+    return ESP_OK;
+}
+
+static void *viewer_thread(void *arg)
+{
+    viewer_t *v = arg;
+
+    while (!atomic_load(&s_stop))
+    {
+        const pipeline_frame_t *frame = frame_fanout_acquire(s_fanout, &v->reader, 50);
+        if (!frame)
+        {
+            continue;
+        }
+        frame_fanout_stats_t fs;
+        frame_fanout_get_stats(s_fanout, &fs);
+        unsigned prev = atomic_load(&s_max_held);
+        while (fs.held > prev && !atomic_compare_exchange_weak(&s_max_held, &prev, fs.held))
+        {
+        }
+        if (v->stuck)
+        {
+            // Checked below: the slot is still intact at the end of the run
+            while (!atomic_load(&s_stop))
+            {
+                test_sleep_ms(5);
+            }
+        }
+        else if (v->work_ms)
+        {
+            test_sleep_ms(v->work_ms);
+        }
+        if (!frame_intact(frame))
+        {
+            atomic_fetch_add(&s_corrupt, 1);
+        }
+        frame_fanout_release(s_fanout, frame);
+    }
+    return NULL;
+}
+
+// Run the pipeline for RUN_MS with the given viewers, or without the fan-out
+// if there are none; returns its counters
+static capture_pipeline_stats_t run(viewer_t *viewers, int num_viewers, source_t *src)
+{
+    pthread_t threads[4];
+    capture_pipeline_handle_t p;
+    capture_pipeline_stats_t s;
+
+    capture_pipeline_config_t cfg = {
+        .source = { .capture = source_capture, .ctx = src },
+        .uploader = { .upload = slow_upload },
+        .queue_len = 3,
+        .frame_capacity = FRAME_BYTES,
+        .capture_interval_ms = INTERVAL_MS,
+        .task_stack_size = 4096,
+        .task_priority = 5,
+    };
+    if (num_viewers > 0)
+    {
+        CHECK_EQ(frame_fanout_create(&s_fanout), ESP_OK);
+        cfg.tap = (frame_tap_t){ .publish = frame_fanout_publish, .ctx = s_fanout };
+        cfg.tap_slots = 1 + num_viewers;
+    }
+
+    atomic_store(&s_stop, false);
+    CHECK_EQ(capture_pipeline_start(&cfg, &p), ESP_OK);
+    for (int i = 0; i < num_viewers; i++)
+    {
+        pthread_create(&threads[i], NULL, viewer_thread, &viewers[i]);
+    }
+    test_sleep_ms(RUN_MS);
+    capture_pipeline_get_stats(p, &s);
+    atomic_store(&s_stop, true);
+    for (int i = 0; i < num_viewers; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    CHECK_EQ(capture_pipeline_stop(p), ESP_OK);
+    return s;
+}
+
+static void test_fairness(void)
+{
+    source_t alone_src = {0}, src = {0};
+    viewer_t viewers[] = {
+        { .name = "fast" },
+        { .name = "slow", .work_ms = 100 },
+        { .name = "stuck", .stuck = true },
+    };
+    const int num_viewers = sizeof(viewers) / sizeof(viewers[0]);
+
+    capture_pipeline_stats_t alone = run(NULL, 0, &alone_src);
+    printf("no fan-out:      captured %u, uploaded %u, dropped %u\n", alone.captured, alone.uploaded, alone.dropped);
+
+    capture_pipeline_stats_t s = run(viewers, num_viewers, &src);
+    frame_fanout_stats_t fs;
+    frame_fanout_get_stats(s_fanout, &fs);
+    printf("with %d viewers: captured %u, uploaded %u, dropped %u, longest capture gap %lld ms\n", num_viewers,
+           s.captured, s.uploaded, s.dropped, (long long)(src.max_gap_us / 1000));
+    for (int i = 0; i < num_viewers; i++)
+    {
+        printf("  %-5s viewer: %4u frames, %4u skipped\n", viewers[i].name, viewers[i].reader.frames,
+               viewers[i].reader.skipped);
+    }
+    printf("published %u, most references held at once %u\n", fs.published, atomic_load(&s_max_held));
+
+    // Counters only: the capture gap and frame rates above are printed, since a
+    // loaded host stretches them whatever the fan-out does
+    CHECK_EQ(atomic_load(&s_corrupt), 0);
+    // The uploader and capture run about as if no one were watching; both runs
+    // see the same host, so only a viewer holding them up would halve these
+    CHECK(s.uploaded * 4 >= alone.uploaded * 3);
+    CHECK(s.captured * 4 >= alone.captured * 3);
+    CHECK(s.dropped > 0);
+    // The slow viewer spends 100 ms on each frame and skips the ones that came
+    // meanwhile, the fast one takes more of them, and the stuck one holds a
+    // single frame without starving anyone of slots
+    CHECK(viewers[1].reader.frames > 0 && viewers[1].reader.frames <= RUN_MS / 100 + 1);
+    CHECK(viewers[1].reader.skipped > viewers[1].reader.frames);
+    CHECK(viewers[0].reader.frames > viewers[1].reader.frames);
+    CHECK_EQ(viewers[2].reader.frames, 1);
+    CHECK(atomic_load(&s_max_held) <= (unsigned)num_viewers + 1);
+}
+
+int main(void)
+{
+    RUN_TEST(test_fairness);
+    printf("All frame fan-out tests passed\n");
+    return 0;
+}
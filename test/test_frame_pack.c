@@ -0,0 +1,306 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "crc32.h"
+#include "frame_pack.h"
+#include "test_util.h"
+
+// Frame packs read back the way a consumer does, from the trailer through the
+// index to each payload; resuming an unfinished pack cut at every byte, as
+// after a reset mid-write; empty packs; and the append rate.
+
+#define MAX_FRAME 40000
+
+static char s_dir[32];
+static char s_path[64];
+static char s_cut[64];
+static uint8_t s_buf[MAX_FRAME];
+
+static void fill(uint8_t *buf, uint32_t len, int64_t seed)
+{
+    for (uint32_t i = 0; i < len; i++)
+    {
+        buf[i] = (uint8_t)(seed * 13 + i * 7);
+    }
+}
+
+static void append(frame_pack_writer_handle_t w, int64_t ts, uint32_t len)
+{
+    frame_pack_entry_t e = {
+        .timestamp_us = ts,
+        .length = len,
+        .width = 160,
+        .height = 120,
+        .format = 1,
+    };
+
+    fill(s_buf, len, ts);
+    CHECK_EQ(frame_pack_writer_append(w, &e, s_buf), ESP_OK);
+}
+
+static uint16_t get16(const uint8_t *p)
+{
+    return p[0] | p[1] << 8;
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+    return get16(p) | (uint32_t)get16(p + 2) << 16;
+}
+
+static uint64_t get64(const uint8_t *p)
+{
+    return get32(p) | (uint64_t)get32(p + 4) << 32;
+}
+
+// Read a finished pack as tools/frame_pack.py does: the trailer, then the
+// index, then each payload at its offset. Checks the CRCs and the payloads
+// written by append(); returns the number of frames.
+static uint32_t read_pack(const char *path, int64_t *first_ts)
+{
+    uint8_t trailer[FRAME_PACK_TRAILER_SIZE];
+    FILE *f = fopen(path, "rb");
+
+    CHECK(f);
+    CHECK_EQ(fseek(f, -FRAME_PACK_TRAILER_SIZE, SEEK_END), 0);
+    long size = ftell(f) + FRAME_PACK_TRAILER_SIZE;
+    CHECK_EQ(fread(trailer, 1, sizeof(trailer), f), sizeof(trailer));
+    CHECK(memcmp(trailer, "FPKX", 4) == 0);
+    CHECK_EQ(get16(trailer + 6), FRAME_PACK_INDEX_ENTRY_SIZE);
+    CHECK_EQ(get32(trailer + 28), crc32_update(0, trailer, 28));
+    uint32_t frames = get32(trailer + 8);
+    uint64_t index_offset = get64(trailer + 16);
+    CHECK_EQ(index_offset + frames * FRAME_PACK_INDEX_ENTRY_SIZE + FRAME_PACK_TRAILER_SIZE, size);
+
+    uint8_t *index = malloc(frames * FRAME_PACK_INDEX_ENTRY_SIZE + 1);
+    CHECK_EQ(fseek(f, index_offset, SEEK_SET), 0);
+    CHECK_EQ(fread(index, 1, frames * FRAME_PACK_INDEX_ENTRY_SIZE, f), frames * FRAME_PACK_INDEX_ENTRY_SIZE);
+    CHECK_EQ(get32(trailer + 12), crc32_update(0, index, frames * FRAME_PACK_INDEX_ENTRY_SIZE));
+
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        static uint8_t expect[MAX_FRAME];
+        const uint8_t *e = index + i * FRAME_PACK_INDEX_ENTRY_SIZE;
+        uint32_t len = get32(e + 8);
+        int64_t ts = (int64_t)get64(e + 16);
+
+        CHECK(len <= MAX_FRAME);
+        CHECK_EQ(get16(e + 24), 160);
+        CHECK_EQ(get16(e + 26), 120);
+        CHECK_EQ(e[28], 1);
+        CHECK_EQ(fseek(f, get64(e), SEEK_SET), 0);
+        CHECK_EQ(fread(s_buf, 1, len, f), len);
+        CHECK_EQ(crc32_update(0, s_buf, len), get32(e + 12));
+        fill(expect, len, ts);
+        CHECK(memcmp(expect, s_buf, len) == 0);
+        if (i == 0 && first_ts)
+        {
+            *first_ts = ts;
+        }
+    }
+    free(index);
+    fclose(f);
+    return frames;
+}
+
+static long file_size(const char *path)
+{
+    struct stat sb;
+
+    return stat(path, &sb) == 0 ? sb.st_size : -1;
+}
+
+// Copy the first len bytes of src to dst
+static void copy_prefix(const char *src, const char *dst, size_t len)
+{
+    static uint8_t data[256 * 1024];
+    FILE *in = fopen(src, "rb");
+    FILE *out = fopen(dst, "wb");
+
+    CHECK(in && out && len <= sizeof(data));
+    CHECK_EQ(fread(data, 1, len, in), len);
+    CHECK_EQ(fwrite(data, 1, len, out), len);
+    fclose(in);
+    fclose(out);
+}
+
+static void test_round_trip(void)
+{
+    frame_pack_writer_handle_t w;
+    frame_pack_info_t info, read;
+    int64_t first = 0;
+
+    remove(s_path);
+    CHECK_EQ(frame_pack_writer_open(s_path, 8, 1700000000000000LL, &w), ESP_OK);
+    for (int i = 0; i < 5; i++)
+    {
+        append(w, 1700000000000000LL + i * 1000, 1000 + i * 3000);
+    }
+    frame_pack_writer_get_info(w, &info);
+    CHECK_EQ(info.frames, 5);
+    CHECK_EQ(info.first_timestamp_us, 1700000000000000LL);
+    size_t predicted = info.size;
+
+    CHECK_EQ(frame_pack_writer_finish(w, &info), ESP_OK);
+    CHECK_EQ(info.size, predicted);
+    CHECK_EQ(file_size(s_path), predicted);
+    CHECK_EQ(frame_pack_read_info(s_path, &read), ESP_OK);
+    CHECK_EQ(read.size, info.size);
+    CHECK_EQ(read.frames, 5);
+    CHECK_EQ(read.first_timestamp_us, 1700000000000000LL);
+    CHECK_EQ(read_pack(s_path, &first), 5);
+    CHECK_EQ(first, 1700000000000000LL);
+}
+
+// A reset while a pack is being filled leaves it cut anywhere. Reopening
+// keeps every frame that is wholly on flash and continues after it.
+static void test_torn_tail(void)
+{
+    const uint32_t lens[] = { 300, 1, 2000, 777 };
+    const int n = sizeof(lens) / sizeof(lens[0]);
+    size_t ends[sizeof(lens) / sizeof(lens[0])];
+    frame_pack_writer_handle_t w;
+    frame_pack_info_t info;
+
+    remove(s_path);
+    CHECK_EQ(frame_pack_writer_open(s_path, 8, 1, &w), ESP_OK);
+    for (int i = 0; i < n; i++)
+    {
+        append(w, 100 + i, lens[i]);
+        frame_pack_writer_get_info(w, &info);
+        ends[i] = info.size - (i + 1) * FRAME_PACK_INDEX_ENTRY_SIZE - FRAME_PACK_TRAILER_SIZE;
+    }
+    CHECK_EQ(frame_pack_writer_finish(w, NULL), ESP_OK);
+
+    // Every cut up to the end of the records, then the index and trailer too
+    const size_t full_size = file_size(s_path);
+    int cuts = 0;
+    for (size_t cut = 0; cut <= full_size; cut++)
+    {
+        copy_prefix(s_path, s_cut, cut);
+        uint32_t whole = 0;
+        while (whole < (uint32_t)n && ends[whole] <= cut)
+        {
+            whole++;
+        }
+
+        CHECK_EQ(frame_pack_writer_open(s_cut, 8, 2, &w), ESP_OK);
+        frame_pack_writer_get_info(w, &info);
+        CHECK_EQ(info.frames, whole);
+        CHECK_EQ(info.first_timestamp_us, whole ? 100 : 0);
+        append(w, 200, 500);
+        CHECK_EQ(frame_pack_writer_finish(w, &info), ESP_OK);
+        CHECK_EQ(info.frames, whole + 1);
+        CHECK_EQ(read_pack(s_cut, NULL), whole + 1);
+        cuts++;
+    }
+    printf("%d cuts of a %zu-byte pack resumed\n", cuts, full_size);
+}
+
+// Reopening a finished pack continues it until it is full
+static void test_resume_finished(void)
+{
+    frame_pack_writer_handle_t w;
+    frame_pack_info_t info;
+
+    remove(s_path);
+    CHECK_EQ(frame_pack_writer_open(s_path, 6, 1, &w), ESP_OK);
+    append(w, 1, 100);
+    append(w, 2, 200);
+    CHECK_EQ(frame_pack_writer_finish(w, NULL), ESP_OK);
+
+    CHECK_EQ(frame_pack_writer_open(s_path, 6, 2, &w), ESP_OK);
+    frame_pack_writer_get_info(w, &info);
+    CHECK_EQ(info.frames, 2);
+    for (int i = 3; i <= 6; i++)
+    {
+        append(w, i, i * 100);
+    }
+    frame_pack_entry_t e = { .timestamp_us = 7, .length = 10 };
+    CHECK_EQ(frame_pack_writer_append(w, &e, s_buf), ESP_ERR_INVALID_STATE);
+    CHECK_EQ(frame_pack_writer_finish(w, &info), ESP_OK);
+    CHECK_EQ(info.frames, 6);
+    CHECK_EQ(read_pack(s_path, NULL), 6);
+}
+
+// A pack without frames has no first timestamp to be named after; the
+// uploader has to recognize it. Not-a-pack and missing files are told apart.
+static void test_empty_and_invalid(void)
+{
+    frame_pack_writer_handle_t w;
+    frame_pack_info_t info;
+
+    remove(s_path);
+    CHECK_EQ(frame_pack_writer_open(s_path, 4, 5, &w), ESP_OK);
+    frame_pack_writer_get_info(w, &info);
+    CHECK_EQ(info.frames, 0);
+    CHECK_EQ(info.first_timestamp_us, 0);
+    CHECK_EQ(frame_pack_writer_finish(w, NULL), ESP_OK);
+    CHECK_EQ(frame_pack_read_info(s_path, &info), ESP_OK);
+    CHECK_EQ(info.frames, 0);
+    CHECK_EQ(info.first_timestamp_us, 0);
+
+    // Abort deletes the file, resumed or not
+    CHECK_EQ(frame_pack_writer_open(s_path, 4, 5, &w), ESP_OK);
+    frame_pack_writer_abort(w);
+    CHECK_EQ(frame_pack_read_info(s_path, &info), ESP_ERR_NOT_FOUND);
+
+    // Unfinished, and a finished pack with a flipped trailer byte
+    CHECK_EQ(frame_pack_writer_open(s_path, 4, 5, &w), ESP_OK);
+    append(w, 9, 1000);
+    CHECK_EQ(frame_pack_writer_finish(w, NULL), ESP_OK);
+    long size = file_size(s_path);
+    copy_prefix(s_path, s_cut, size - 1);
+    CHECK_EQ(frame_pack_read_info(s_cut, &info), ESP_ERR_INVALID_RESPONSE);
+
+    FILE *f = fopen(s_path, "r+b");
+    CHECK(f);
+    CHECK_EQ(fseek(f, size - 10, SEEK_SET), 0);
+    int c = fgetc(f);
+    CHECK_EQ(fseek(f, size - 10, SEEK_SET), 0);
+    fputc(c ^ 0x40, f);
+    fclose(f);
+    CHECK_EQ(frame_pack_read_info(s_path, &info), ESP_ERR_INVALID_RESPONSE);
+    remove(s_path);
+}
+
+static void test_append_rate(void)
+{
+    const uint32_t len = 30000;
+    const int frames = 200;
+    frame_pack_writer_handle_t w;
+
+    remove(s_path);
+    double start = test_now_s();
+    CHECK_EQ(frame_pack_writer_open(s_path, frames, 1, &w), ESP_OK);
+    for (int i = 0; i < frames; i++)
+    {
+        append(w, i, len);
+    }
+    CHECK_EQ(frame_pack_writer_finish(w, NULL), ESP_OK);
+    double elapsed = test_now_s() - start;
+    printf("%d frames of %u bytes: %.0f MB/s including CRC and fsync\n", frames, len,
+           frames * (double)len / elapsed / 1e6);
+    CHECK_EQ(read_pack(s_path, NULL), frames);
+}
+
+int main(void)
+{
+    strcpy(s_dir, "/tmp/packXXXXXX");
+    CHECK(mkdtemp(s_dir));
+    snprintf(s_path, sizeof(s_path), "%s/batch.fpk", s_dir);
+    snprintf(s_cut, sizeof(s_cut), "%s/cut.fpk", s_dir);
+
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_torn_tail);
+    RUN_TEST(test_resume_finished);
+    RUN_TEST(test_empty_and_invalid);
+    RUN_TEST(test_append_rate);
+
+    remove(s_path);
+    remove(s_cut);
+    rmdir(s_dir);
+    printf("All frame pack tests passed\n");
+    return 0;
+}
@@ -0,0 +1,395 @@
+#include <dirent.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "frame_spool.h"
+#include "test_util.h"
+
+// Power-loss recovery of the frame spool: a copy of the segment files taken
+// while the spool is still open stands in for the flash at the moment power
+// is cut, and is reopened after truncating or corrupting it. Also covers the
+// flash budget, resuming a partial replay and the append rate.
+
+#define MAX_RECORD 20000
+
+static char s_dir[32];
+static char s_copy[40];
+static uint8_t s_buf[MAX_RECORD];
+
+static frame_spool_config_t make_config(const char *dir, size_t segment_size, uint32_t max_segments)
+{
+    return (frame_spool_config_t){
+        .dir = dir,
+        .segment_size = segment_size,
+        .max_segments = max_segments,
+        .write_buffer_size = 4096,
+    };
+}
+
+static void fill(uint8_t *buf, uint32_t len, int64_t seed)
+{
+    for (uint32_t i = 0; i < len; i++)
+    {
+        buf[i] = (uint8_t)(seed * 31 + i);
+    }
+}
+
+static void append(frame_spool_handle_t spool, int64_t ts, uint32_t len, uint8_t flags)
+{
+    frame_spool_entry_t e = {
+        .timestamp_us = ts,
+        .length = len,
+        .width = 160,
+        .height = 120,
+        .format = 2,
+        .flags = flags,
+    };
+
+    fill(s_buf, len, ts);
+    CHECK_EQ(frame_spool_append(spool, &e, s_buf), ESP_OK);
+}
+
+// Peek and consume the next record, checking its payload; returns its timestamp
+static int64_t take(frame_spool_handle_t spool, frame_spool_entry_t *out)
+{
+    static uint8_t expect[MAX_RECORD];
+
+    CHECK_EQ(frame_spool_peek(spool, out, s_buf, sizeof(s_buf)), ESP_OK);
+    fill(expect, out->length, out->timestamp_us);
+    CHECK(memcmp(expect, s_buf, out->length) == 0);
+    CHECK_EQ(frame_spool_consume(spool), ESP_OK);
+    return out->timestamp_us;
+}
+
+static void remove_dir(const char *path)
+{
+    char file[320];
+    DIR *dir = opendir(path);
+    struct dirent *de;
+
+    if (!dir)
+    {
+        return;
+    }
+    while ((de = readdir(dir)) != NULL)
+    {
+        if (de->d_name[0] != '.')
+        {
+            snprintf(file, sizeof(file), "%s/%s", path, de->d_name);
+            remove(file);
+        }
+    }
+    closedir(dir);
+    rmdir(path);
+}
+
+// Copy the files of s_dir as they are on disk right now
+static void snapshot(void)
+{
+    char src[320], dst[320];
+    DIR *dir = opendir(s_dir);
+    struct dirent *de;
+
+    remove_dir(s_copy);
+    CHECK_EQ(mkdir(s_copy, 0755), 0);
+    CHECK(dir);
+    while ((de = readdir(dir)) != NULL)
+    {
+        if (de->d_name[0] == '.')
+        {
+            continue;
+        }
+        snprintf(src, sizeof(src), "%s/%s", s_dir, de->d_name);
+        snprintf(dst, sizeof(dst), "%s/%s", s_copy, de->d_name);
+        FILE *in = fopen(src, "rb"), *out = fopen(dst, "wb");
+        CHECK(in && out);
+        size_t n;
+        while ((n = fread(s_buf, 1, sizeof(s_buf), in)) > 0)
+        {
+            CHECK_EQ(fwrite(s_buf, 1, n, out), n);
+        }
+        fclose(in);
+        fclose(out);
+    }
+    closedir(dir);
+}
+
+static void new_spool_dir(void)
+{
+    remove_dir(s_dir);
+    CHECK_EQ(mkdir(s_dir, 0755), 0);
+}
+
+// Records come back in order with their metadata and flags. Records written
+// since open are not marked recovered; after a reopen they all are.
+static void test_round_trip(void)
+{
+    frame_spool_config_t cfg = make_config(s_dir, 16384, 4);
+    frame_spool_handle_t spool;
+    frame_spool_entry_t e;
+
+    new_spool_dir();
+    CHECK_EQ(frame_spool_open(&cfg, &spool), ESP_OK);
+    CHECK_EQ(frame_spool_peek(spool, &e, s_buf, sizeof(s_buf)), ESP_ERR_NOT_FOUND);
+    for (int i = 0; i < 10; i++)
+    {
+        append(spool, 1000 + i, 500 + i * 10, i % 2 ? FRAME_SPOOL_FLAG_BOOT_TIME : 0);
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        CHECK_EQ(take(spool, &e), 1000 + i);
+        CHECK_EQ(e.length, 500 + i * 10);
+        CHECK_EQ(e.width, 160);
+        CHECK_EQ(e.height, 120);
+        CHECK_EQ(e.format, 2);
+        CHECK_EQ(e.flags, i % 2 ? FRAME_SPOOL_FLAG_BOOT_TIME : 0);
+        CHECK(!e.recovered);
+    }
+
+    // Interleaved appends and reads on the segment being written
+    for (int i = 0; i < 5; i++)
+    {
+        append(spool, 2000 + i, 300, 0);
+    }
+    frame_spool_close(spool);
+
+    CHECK_EQ(frame_spool_open(&cfg, &spool), ESP_OK);
+    frame_spool_stats_t st;
+    frame_spool_get_stats(spool, &st);
+    // The consumed records share a segment with the rest, so they come back
+    CHECK_EQ(st.pending, 15);
+    append(spool, 3000, 100, 0);
+    for (int i = 0; i < 15; i++)
+    {
+        take(spool, &e);
+        CHECK(e.recovered);
+        CHECK_EQ(e.flags, e.timestamp_us < 2000 && e.timestamp_us % 2 ? FRAME_SPOOL_FLAG_BOOT_TIME : 0);
+    }
+    CHECK_EQ(take(spool, &e), 3000);
+    CHECK(!e.recovered);
+    CHECK_EQ(frame_spool_peek(spool, &e, s_buf, sizeof(s_buf)), ESP_ERR_NOT_FOUND);
+    frame_spool_close(spool);
+}
+
+// Power cut at every byte of the newest segment: every record that reached
+// the file intact is recovered, nothing after a cut is, and the spool carries
+// on appending after the truncated tail
+static void test_torn_tail(void)
+{
+    frame_spool_config_t cfg = make_config(s_dir, 16384, 4);
+    frame_spool_handle_t spool;
+    const int records = 5;
+    const uint32_t len = 100;
+    const size_t record_size = 32 + len, seg_header = 16;
+
+    new_spool_dir();
+    CHECK_EQ(frame_spool_open(&cfg, &spool), ESP_OK);
+    for (int i = 0; i < records; i++)
+    {
+        append(spool, i, len, 0);
+    }
+    CHECK_EQ(frame_spool_flush(spool), ESP_OK);
+    snapshot();
+    frame_spool_close(spool);
+
+    char seg[64];
+    snprintf(seg, sizeof(seg), "%s/00000001.seg", s_copy);
+    struct stat sb;
+    CHECK_EQ(stat(seg, &sb), 0);
+    const size_t full_size = sb.st_size;
+    CHECK_EQ(full_size, seg_header + records * record_size);
+
+    frame_spool_config_t copy_cfg = make_config(s_copy, 16384, 4);
+    for (size_t cut = seg_header; cut <= full_size; cut++)
+    {
+        snapshot();
+        CHECK_EQ(truncate(seg, cut), 0);
+        CHECK_EQ(frame_spool_open(&copy_cfg, &spool), ESP_OK);
+
+        uint32_t intact = (cut - seg_header) / record_size;
+        frame_spool_stats_t st;
+        frame_spool_get_stats(spool, &st);
+        CHECK_EQ(st.pending, intact);
+        CHECK_EQ(stat(seg, &sb), 0);
+        CHECK_EQ(sb.st_size, seg_header + intact * record_size);
+
+        append(spool, 100, len, 0);
+        frame_spool_entry_t e;
+        for (uint32_t i = 0; i < intact; i++)
+        {
+            CHECK_EQ(take(spool, &e), i);
+            CHECK(e.recovered);
+        }
+        CHECK_EQ(take(spool, &e), 100);
+        CHECK(!e.recovered);
+        CHECK_EQ(frame_spool_peek(spool, &e, s_buf, sizeof(s_buf)), ESP_ERR_NOT_FOUND);
+        frame_spool_close(spool);
+    }
+    printf("recovered after %zu cut points\n", full_size - seg_header + 1);
+}
+
+// A payload damaged on flash fails its CRC on replay and is dropped; its
+// neighbours are delivered
+static void test_corrupt_payload(void)
+{
+    frame_spool_config_t cfg = make_config(s_dir, 16384, 4);
+    frame_spool_handle_t spool;
+    frame_spool_entry_t e;
+
+    new_spool_dir();
+    CHECK_EQ(frame_spool_open(&cfg, &spool), ESP_OK);
+    for (int i = 0; i < 3; i++)
+    {
+        append(spool, i, 200, 0);
+    }
+    frame_spool_close(spool);
+
+    char seg[64];
+    snprintf(seg, sizeof(seg), "%s/00000001.seg", s_dir);
+    FILE *f = fopen(seg, "r+b");
+    CHECK(f);
+    // Inside the payload of the second record
+    const long offset = 16 + 232 + 32 + 50;
+    fseek(f, offset, SEEK_SET);
+    int c = fgetc(f);
+    fseek(f, offset, SEEK_SET);
+    fputc(c ^ 0x5a, f);
+    fclose(f);
+
+    CHECK_EQ(frame_spool_open(&cfg, &spool), ESP_OK);
+    CHECK_EQ(take(spool, &e), 0);
+    CHECK_EQ(take(spool, &e), 2);
+    CHECK_EQ(frame_spool_peek(spool, &e, s_buf, sizeof(s_buf)), ESP_ERR_NOT_FOUND);
+    frame_spool_stats_t st;
+    frame_spool_get_stats(spool, &st);
+    CHECK_EQ(st.dropped, 1);
+    CHECK_EQ(st.replayed, 2);
+    frame_spool_close(spool);
+}
+
+// Past the flash budget the oldest segment goes; what is left is the newest
+// frames, in order, and every appended frame is accounted for
+static void test_budget(void)
+{
+    const uint32_t max_segments = 3;
+    frame_spool_config_t cfg = make_config(s_dir, 8192, max_segments);
+    frame_spool_handle_t spool;
+    frame_spool_entry_t e;
+    const int frames = 200;
+
+    new_spool_dir();
+    CHECK_EQ(frame_spool_open(&cfg, &spool), ESP_OK);
+    for (int i = 0; i < frames; i++)
+    {
+        append(spool, i, 500 + i % 300, 0);
+    }
+    frame_spool_stats_t st;
+    frame_spool_get_stats(spool, &st);
+    printf("%u appended, %u pending in %u segments, %u dropped\n", st.appended, st.pending, st.segments, st.dropped);
+    CHECK(st.dropped > 0);
+    CHECK(st.segments <= max_segments);
+    CHECK_EQ(st.pending + st.dropped, frames);
+
+    int64_t first = -1, last = -1;
+    uint32_t n = 0;
+    while (frame_spool_peek(spool, &e, s_buf, sizeof(s_buf)) == ESP_OK)
+    {
+        int64_t ts = take(spool, &e);
+        CHECK(ts > last);
+        first = first < 0 ? ts : first;
+        last = ts;
+        n++;
+    }
+    CHECK_EQ(n, st.pending);
+    CHECK_EQ(first, st.dropped);
+    CHECK_EQ(last, frames - 1);
+    frame_spool_close(spool);
+}
+
+// A reboot in the middle of a replay: fully replayed segments are gone, the
+// rest is delivered again, oldest first
+static void test_resume_replay(void)
+{
+    frame_spool_config_t cfg = make_config(s_dir, 4096, 16);
+    frame_spool_handle_t spool;
+    frame_spool_entry_t e;
+    const int frames = 60;
+
+    new_spool_dir();
+    CHECK_EQ(frame_spool_open(&cfg, &spool), ESP_OK);
+    for (int i = 0; i < frames; i++)
+    {
+        append(spool, i, 400, 0);
+    }
+    for (int i = 0; i < 25; i++)
+    {
+        CHECK_EQ(take(spool, &e), i);
+    }
+    frame_spool_stats_t before;
+    frame_spool_get_stats(spool, &before);
+    frame_spool_close(spool);
+
+    CHECK_EQ(frame_spool_open(&cfg, &spool), ESP_OK);
+    frame_spool_stats_t after;
+    frame_spool_get_stats(spool, &after);
+    printf("%u pending before the reboot, %u after\n", before.pending, after.pending);
+    // Frames per 4 KiB segment: (4096 - 16) / 432 = 9
+    CHECK(after.pending >= before.pending && after.pending < before.pending + 9);
+    int64_t ts = take(spool, &e);
+    CHECK(ts <= 25 && ts > 25 - 9);
+    for (int64_t expect = ts + 1; expect < frames; expect++)
+    {
+        CHECK_EQ(take(spool, &e), expect);
+    }
+    frame_spool_close(spool);
+}
+
+static void test_append_rate(void)
+{
+    frame_spool_config_t cfg = make_config(s_dir, 1 << 20, 64);
+    cfg.write_buffer_size = 16384;
+    frame_spool_handle_t spool;
+    const int frames = 5000;
+    const uint32_t len = 2500;
+
+    new_spool_dir();
+    CHECK_EQ(frame_spool_open(&cfg, &spool), ESP_OK);
+    frame_spool_entry_t e = { .length = len };
+    fill(s_buf, len, 0);
+    double start = test_now_s();
+    for (int i = 0; i < frames; i++)
+    {
+        e.timestamp_us = i;
+        CHECK_EQ(frame_spool_append(spool, &e, s_buf), ESP_OK);
+    }
+    CHECK_EQ(frame_spool_flush(spool), ESP_OK);
+    double elapsed = test_now_s() - start;
+
+    frame_spool_stats_t st;
+    frame_spool_get_stats(spool, &st);
+    printf("%d frames of %u bytes: %.1f MB/s, %.1f%% header overhead\n", frames, len,
+           st.bytes_written / elapsed / 1e6, 100.0 * (st.bytes_written - st.payload_bytes) / st.bytes_written);
+    CHECK_EQ(st.payload_bytes, (uint64_t)frames * len);
+    frame_spool_close(spool);
+}
+
+int main(void)
+{
+    strcpy(s_dir, "/tmp/spoolXXXXXX");
+    CHECK(mkdtemp(s_dir));
+    snprintf(s_copy, sizeof(s_copy), "%s.cut", s_dir);
+
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_torn_tail);
+    RUN_TEST(test_corrupt_payload);
+    RUN_TEST(test_budget);
+    RUN_TEST(test_resume_replay);
+    RUN_TEST(test_append_rate);
+
+    remove_dir(s_copy);
+    remove_dir(s_dir);
+    printf("All frame spool tests passed\n");
+    return 0;
+}
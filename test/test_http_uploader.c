@@ -0,0 +1,291 @@
+#include <netdb.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <esp_tls.h>
+#include <sys/socket.h>
+#include "http_uploader.h"
+#include "http_test_server.h"
+#include "test_util.h"
+
+// The PUT client against a local stand-in server: connection reuse, bytes on
+// the wire, streamed request bodies and chunked responses, servers closing
+// connections with and without warning, a server that never answers, and a
+// single name lookup per connection
+
+#define BODY_LEN 38400
+
+static uint8_t s_body[1 << 20];
+static char s_origin[64];
+
+static void fill_body(void)
+{
+    for (size_t i = 0; i < sizeof(s_body); i++)
+    {
+        s_body[i] = (uint8_t)(i * 7 + (i >> 11));
+    }
+}
+
+static http_uploader_handle_t make_uploader(int timeout_ms)
+{
+    http_uploader_config_t cfg = {
+        .chunk_size = 1000,
+        .timeout_ms = timeout_ms,
+        .idle_timeout_ms = 5000,
+    };
+    http_uploader_handle_t up;
+
+    CHECK_EQ(http_uploader_create(&cfg, &up), ESP_OK);
+    return up;
+}
+
+static void check_request(test_http_server_t *server, size_t i, const char *path, size_t body_len)
+{
+    test_http_request_t req;
+
+    CHECK_EQ(test_http_server_get_request(server, i, &req), 0);
+    CHECK(strcmp(req.method, "PUT") == 0);
+    CHECK(strcmp(req.path, path) == 0);
+    CHECK_EQ(req.body_len, body_len);
+    CHECK(memcmp(req.body, s_body, body_len) == 0);
+    test_http_request_free(&req);
+}
+
+// Back-to-back PUTs share one connection, and everything counted as sent is
+// the request heads plus the bodies
+static void test_keep_alive(void)
+{
+    test_http_server_t *server = test_http_server_start();
+    http_uploader_handle_t up = make_uploader(2000);
+    char url[128];
+    int status = 0;
+
+    snprintf(s_origin, sizeof(s_origin), "http://127.0.0.1:%d", test_http_server_port(server));
+    double start = test_now_s();
+    const int puts = 50;
+    for (int i = 0; i < puts; i++)
+    {
+        snprintf(url, sizeof(url), "%s/frames/%d.jpg?X-Amz-Test=%d", s_origin, i, i);
+        CHECK_EQ(http_uploader_put(up, url, "image/jpeg", i == 0 ? "X-Extra: yes\r\n" : NULL, s_body, BODY_LEN,
+                                   &status), ESP_OK);
+        CHECK_EQ(status, 200);
+    }
+    double elapsed = test_now_s() - start;
+
+    http_uploader_stats_t stats;
+    http_uploader_get_stats(up, &stats);
+    printf("%d PUTs of %d bytes in %.3f s (%.1f MB/s), %u connection(s), setup %lld us\n", puts, BODY_LEN, elapsed,
+           puts * (double)BODY_LEN / elapsed / 1e6, stats.connections, (long long)stats.last_connect_us);
+    CHECK_EQ(stats.requests, puts);
+    CHECK_EQ(stats.connections, 1);
+    // With Nagle on, each request's short tail would wait ~40 ms for a delayed ACK
+    host_tls_stats_t tls;
+    host_tls_get_stats(&tls);
+    CHECK(tls.nodelay);
+    CHECK_EQ(test_http_server_connection_count(server), 1);
+    CHECK(stats.last_connect_us > 0 && (uint64_t)stats.last_connect_us == stats.connect_time_us);
+    // Heads are a couple of hundred bytes each
+    CHECK(stats.bytes_sent > (uint64_t)puts * BODY_LEN);
+    CHECK(stats.bytes_sent < (uint64_t)puts * (BODY_LEN + 512));
+
+    CHECK_EQ(test_http_server_request_count(server), puts);
+    check_request(server, 0, "/frames/0.jpg?X-Amz-Test=0", BODY_LEN);
+    check_request(server, puts - 1, "/frames/49.jpg?X-Amz-Test=49", BODY_LEN);
+
+    test_http_request_t req;
+    char value[128], host[64];
+    CHECK_EQ(test_http_server_get_request(server, 0, &req), 0);
+    snprintf(host, sizeof(host), "127.0.0.1:%d", test_http_server_port(server));
+    CHECK(test_http_header(&req, "Host", value, sizeof(value)) && strcmp(value, host) == 0);
+    CHECK(test_http_header(&req, "Content-Type", value, sizeof(value)) && strcmp(value, "image/jpeg") == 0);
+    CHECK(test_http_header(&req, "X-Extra", value, sizeof(value)) && strcmp(value, "yes") == 0);
+    test_http_request_free(&req);
+
+    http_uploader_delete(up);
+    test_http_server_stop(server);
+}
+
+// A body streamed in pieces that do not line up with the chunk size arrives
+// intact under its announced length, a chunked error response is read to its
+// end, and the connection stays usable afterwards
+static void test_streamed_body(void)
+{
+    test_http_server_t *server = test_http_server_start();
+    http_uploader_handle_t up = make_uploader(2000);
+    char url[128];
+    int status = 0;
+
+    snprintf(s_origin, sizeof(s_origin), "http://127.0.0.1:%d", test_http_server_port(server));
+    snprintf(url, sizeof(url), "%s/chunkresp", s_origin);
+    CHECK_EQ(http_uploader_begin(up, url, "application/octet-stream", NULL, BODY_LEN), ESP_OK);
+    for (size_t i = 0; i < BODY_LEN; i += 777)
+    {
+        size_t n = BODY_LEN - i < 777 ? BODY_LEN - i : 777;
+        CHECK_EQ(http_uploader_write(up, s_body + i, n), ESP_OK);
+    }
+    CHECK_EQ(http_uploader_finish(up, &status), ESP_OK);
+    CHECK_EQ(status, 403);
+    check_request(server, 0, "/chunkresp", BODY_LEN);
+
+    snprintf(url, sizeof(url), "%s/after", s_origin);
+    CHECK_EQ(http_uploader_put(up, url, "image/jpeg", NULL, s_body, 1234, &status), ESP_OK);
+    CHECK_EQ(status, 200);
+    check_request(server, 1, "/after", 1234);
+
+    http_uploader_stats_t stats;
+    http_uploader_get_stats(up, &stats);
+    CHECK_EQ(stats.connections, 1);
+
+    // Announcing a length and sending less, or more, fails the request
+    CHECK_EQ(http_uploader_begin(up, url, "image/jpeg", NULL, 100), ESP_OK);
+    CHECK_EQ(http_uploader_write(up, s_body, 50), ESP_OK);
+    CHECK_EQ(http_uploader_finish(up, &status), ESP_ERR_INVALID_SIZE);
+    CHECK_EQ(http_uploader_begin(up, url, "image/jpeg", NULL, 100), ESP_OK);
+    CHECK_EQ(http_uploader_write(up, s_body, 150), ESP_OK);
+    CHECK_EQ(http_uploader_finish(up, &status), ESP_ERR_INVALID_SIZE);
+
+    http_uploader_delete(up);
+    test_http_server_stop(server);
+}
+
+// "Connection: close" is honoured, and a connection the server dropped
+// silently is retried once on a fresh one
+static void test_server_close(void)
+{
+    test_http_server_t *server = test_http_server_start();
+    http_uploader_handle_t up = make_uploader(2000);
+    char url[128];
+    int status = 0;
+
+    snprintf(s_origin, sizeof(s_origin), "http://127.0.0.1:%d", test_http_server_port(server));
+    snprintf(url, sizeof(url), "%s/close", s_origin);
+    CHECK_EQ(http_uploader_put(up, url, "image/jpeg", NULL, s_body, 100, &status), ESP_OK);
+    snprintf(url, sizeof(url), "%s/drop", s_origin);
+    CHECK_EQ(http_uploader_put(up, url, "image/jpeg", NULL, s_body, 100, &status), ESP_OK);
+    CHECK(WAIT_FOR(test_http_server_connection_count(server) == 2, 1000));
+    test_sleep_ms(50);  // Let the drop reach the client's socket
+
+    snprintf(url, sizeof(url), "%s/retried", s_origin);
+    CHECK_EQ(http_uploader_put(up, url, "image/jpeg", NULL, s_body, BODY_LEN, &status), ESP_OK);
+    CHECK_EQ(status, 200);
+
+    http_uploader_stats_t stats;
+    http_uploader_get_stats(up, &stats);
+    CHECK_EQ(stats.connections, 3);
+    CHECK_EQ(test_http_server_request_count(server), 3);
+    check_request(server, 2, "/retried", BODY_LEN);
+
+    http_uploader_delete(up);
+    test_http_server_stop(server);
+}
+
+// A server that never answers costs one timeout, spent waiting on the socket
+// rather than spinning on WANT_READ
+static void test_stalled_server(void)
+{
+    test_http_server_t *server = test_http_server_start();
+    http_uploader_handle_t up = make_uploader(300);
+    char url[128];
+    int status = 0;
+    host_tls_stats_t before, after;
+
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/stall", test_http_server_port(server));
+    host_tls_get_stats(&before);
+    double start = test_now_s();
+    esp_err_t err = http_uploader_put(up, url, "image/jpeg", NULL, s_body, 100, &status);
+    double elapsed = test_now_s() - start;
+    host_tls_get_stats(&after);
+
+    printf("stalled request failed with %s after %.3f s, %u WANT results\n", esp_err_to_name(err), elapsed,
+           after.want_results - before.want_results);
+    CHECK_EQ(err, ESP_ERR_TIMEOUT);
+    // The timeout has to have passed; how long past it depends on the host's load
+    CHECK(elapsed >= 0.25);
+    CHECK(after.want_results - before.want_results < 10);
+
+    http_uploader_delete(up);
+    test_http_server_stop(server);
+}
+
+// A body much larger than the socket buffer makes writes wait for room
+static void test_large_body(void)
+{
+    test_http_server_t *server = test_http_server_start();
+    http_uploader_handle_t up = make_uploader(2000);
+    char url[128];
+    int status = 0;
+    host_tls_stats_t before, after;
+
+    host_tls_set_sndbuf(4096);
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/large", test_http_server_port(server));
+    host_tls_get_stats(&before);
+    double start = test_now_s();
+    CHECK_EQ(http_uploader_put(up, url, "application/octet-stream", NULL, s_body, sizeof(s_body), &status), ESP_OK);
+    double elapsed = test_now_s() - start;
+    host_tls_get_stats(&after);
+    host_tls_set_sndbuf(0);
+
+    unsigned waits = after.want_results - before.want_results;
+    printf("%zu bytes in %.3f s (%.1f MB/s), %u waits for socket room\n", sizeof(s_body), elapsed,
+           sizeof(s_body) / elapsed / 1e6, waits);
+    CHECK_EQ(status, 200);
+    check_request(server, 0, "/large", sizeof(s_body));
+    // Each wait ends when the buffer has room again, so they are bounded by the fills
+    CHECK(waits < sizeof(s_body) / 256);
+
+    http_uploader_delete(up);
+    test_http_server_stop(server);
+}
+
+// The name is looked up once; esp_tls gets the address and the name only for
+// SNI and the certificate check
+static void test_single_lookup(void)
+{
+    struct addrinfo hints = { .ai_socktype = SOCK_STREAM };
+    struct addrinfo *res;
+    CHECK_EQ(getaddrinfo("localhost", NULL, &hints, &res), 0);
+    bool ipv4 = res->ai_family == AF_INET;
+    freeaddrinfo(res);
+    if (!ipv4)
+    {
+        printf("localhost is not IPv4 here, skipped\n");
+        return;
+    }
+
+    test_http_server_t *server = test_http_server_start();
+    http_uploader_handle_t up = make_uploader(2000);
+    char url[128];
+    int status = 0;
+
+    snprintf(url, sizeof(url), "http://localhost:%d/named", test_http_server_port(server));
+    CHECK_EQ(http_uploader_put(up, url, "image/jpeg", NULL, s_body, 10, &status), ESP_OK);
+
+    host_tls_stats_t stats;
+    host_tls_get_stats(&stats);
+    CHECK(strcmp(stats.hostname, "127.0.0.1") == 0);
+    CHECK(strcmp(stats.common_name, "localhost") == 0);
+    CHECK_EQ(stats.port, test_http_server_port(server));
+
+    // An unresolvable name fails before any connect
+    unsigned connects = stats.connects;
+    CHECK_EQ(http_uploader_put(up, "http://no-such-host.invalid/x", "image/jpeg", NULL, s_body, 10, &status),
+             ESP_FAIL);
+    host_tls_get_stats(&stats);
+    CHECK_EQ(stats.connects, connects);
+
+    http_uploader_delete(up);
+    test_http_server_stop(server);
+}
+
+int main(void)
+{
+    fill_body();
+    RUN_TEST(test_keep_alive);
+    RUN_TEST(test_streamed_body);
+    RUN_TEST(test_server_close);
+    RUN_TEST(test_stalled_server);
+    RUN_TEST(test_large_body);
+    RUN_TEST(test_single_lookup);
+    printf("All HTTP uploader tests passed\n");
+    return 0;
+}
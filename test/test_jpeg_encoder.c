@@ -0,0 +1,226 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "jpeg_encoder.h"
+#include "test_util.h"
+
+#if HAVE_LIBJPEG
+#include <jpeglib.h>
+#endif
+
+// Encode speed, compression ratio and, when libjpeg is available to decode
+// the output, reconstruction error of the RGB565 JPEG encoder
+
+typedef enum {
+    SCENE_GRADIENT,     // Smooth ramps, the easy case
+    SCENE_TEXTURE,      // Sine pattern with fine detail
+    SCENE_BARS,         // Pure red, green, blue, white and black: the chroma extremes
+    SCENE_NOISE,        // White noise, the worst case for size
+} scene_t;
+
+static const char *const scene_names[] = { "gradient", "texture", "bars", "noise" };
+
+// Big-endian RGB565, as the camera delivers it
+static uint8_t *make_scene(scene_t scene, int w, int h)
+{
+    uint8_t *img = malloc((size_t)w * h * 2);
+    uint32_t rng = 12345;
+
+    CHECK(img);
+    for (int y = 0; y < h; y++)
+    {
+        for (int x = 0; x < w; x++)
+        {
+            int r, g, b;
+            switch (scene)
+            {
+            case SCENE_GRADIENT:
+                r = x * 31 / w;
+                g = (x + y) * 63 / (w + h);
+                b = y * 31 / h;
+                break;
+            case SCENE_TEXTURE:
+                r = (int)(16 + 15 * sin(x * 0.21 + y * 0.05));
+                g = (int)(32 + 31 * sin(x * 0.07 - y * 0.13));
+                b = (int)(16 + 15 * cos((x + y) * 0.11));
+                break;
+            case SCENE_BARS:
+            {
+                int bar = x * 5 / w;
+                r = bar == 0 || bar == 3 ? 31 : 0;
+                g = bar == 1 || bar == 3 ? 63 : 0;
+                b = bar == 2 || bar == 3 ? 31 : 0;
+                break;
+            }
+            default:
+                rng = rng * 1103515245 + 12345;
+                r = (rng >> 8) & 31;
+                g = (rng >> 16) & 63;
+                b = (rng >> 24) & 31;
+                break;
+            }
+            uint16_t p = (uint16_t)(r << 11 | g << 5 | b);
+            img[(y * w + x) * 2] = p >> 8;
+            img[(y * w + x) * 2 + 1] = p & 0xff;
+        }
+    }
+    return img;
+}
+
+#if HAVE_LIBJPEG
+// PSNR of the decoded JPEG against the RGB565 source expanded to 8 bits
+static double decode_psnr(const uint8_t *jpeg, size_t len, const uint8_t *rgb565, int w, int h)
+{
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, jpeg, len);
+    CHECK_EQ(jpeg_read_header(&cinfo, TRUE), JPEG_HEADER_OK);
+    cinfo.out_color_space = JCS_RGB;
+    jpeg_start_decompress(&cinfo);
+    CHECK_EQ(cinfo.output_width, w);
+    CHECK_EQ(cinfo.output_height, h);
+    CHECK_EQ(cinfo.output_components, 3);
+
+    uint8_t *row = malloc((size_t)w * 3);
+    double sse = 0;
+    while (cinfo.output_scanline < cinfo.output_height)
+    {
+        int y = cinfo.output_scanline;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+        for (int x = 0; x < w; x++)
+        {
+            uint16_t p = (uint16_t)(rgb565[(y * w + x) * 2] << 8 | rgb565[(y * w + x) * 2 + 1]);
+            int ref[3] = { (p >> 11) * 255 / 31, ((p >> 5) & 63) * 255 / 63, (p & 31) * 255 / 31 };
+            for (int c = 0; c < 3; c++)
+            {
+                double d = row[x * 3 + c] - ref[c];
+                sse += d * d;
+            }
+        }
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    free(row);
+
+    double mse = sse / ((double)w * h * 3);
+    return mse == 0 ? 99.0 : 10 * log10(255.0 * 255.0 / mse);
+}
+#endif
+
+// Size, speed and quality per scene at a few quality settings, all from one
+// encoder whose quality is changed between frames like the rate controller does
+static void test_scenes(void)
+{
+    const int w = 320, h = 240;
+    const int qualities[] = { 30, 60, 80, 95 };
+    jpeg_encoder_handle_t enc;
+    uint8_t *out = malloc((size_t)w * h * 2);
+
+    CHECK_EQ(jpeg_encoder_create(w, h, 80, &enc), ESP_OK);
+    for (scene_t scene = SCENE_GRADIENT; scene <= SCENE_NOISE; scene++)
+    {
+        uint8_t *img = make_scene(scene, w, h);
+        size_t prev_len = 0;
+
+        for (size_t i = 0; i < sizeof(qualities) / sizeof(qualities[0]); i++)
+        {
+            size_t len = 0;
+            CHECK_EQ(jpeg_encoder_set_quality(enc, qualities[i]), ESP_OK);
+            CHECK_EQ(jpeg_encoder_encode(enc, img, w, h, out, (size_t)w * h * 2, &len), ESP_OK);
+            CHECK_EQ(jpeg_encoder_get_quality(enc), qualities[i]);
+            CHECK(len > 0 && out[0] == 0xff && out[1] == 0xd8);
+            CHECK(out[len - 2] == 0xff && out[len - 1] == 0xd9);
+            // Higher quality never produces a smaller file
+            CHECK(len >= prev_len);
+            prev_len = len;
+
+            const int runs = 20;
+            double start = test_now_s();
+            for (int r = 0; r < runs; r++)
+            {
+                jpeg_encoder_encode(enc, img, w, h, out, (size_t)w * h * 2, &len);
+            }
+            double mbps = runs * (double)w * h * 2 / (test_now_s() - start) / 1e6;
+
+#if HAVE_LIBJPEG
+            double psnr = decode_psnr(out, len, img, w, h);
+            printf("%-8s q%-3d %6zu bytes  ratio %5.1f  %6.1f MB/s  PSNR %.1f dB\n", scene_names[scene],
+                   qualities[i], len, (double)w * h * 2 / len, mbps, psnr);
+            if (scene != SCENE_NOISE && qualities[i] >= 80)
+            {
+                CHECK(psnr > 30.0);
+            }
+            // Pixel noise loses most of its chroma to 4:2:0 subsampling; only catch garbage
+            CHECK(psnr > 8.0);
+#else
+            printf("%-8s q%-3d %6zu bytes  ratio %5.1f  %6.1f MB/s\n", scene_names[scene], qualities[i], len,
+                   (double)w * h * 2 / len, mbps);
+#endif
+        }
+        free(img);
+    }
+    jpeg_encoder_delete(enc);
+    free(out);
+}
+
+// Sizes that are not a multiple of the 16x16 MCU, and frames smaller than the
+// encoder's maximum, pad their edge blocks instead of reading past the image
+static void test_odd_sizes(void)
+{
+    const int sizes[][2] = { { 1, 1 }, { 17, 9 }, { 100, 75 }, { 161, 120 } };
+    jpeg_encoder_handle_t enc;
+    uint8_t out[64 * 1024];
+
+    CHECK_EQ(jpeg_encoder_create(161, 120, 75, &enc), ESP_OK);
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        int w = sizes[i][0], h = sizes[i][1];
+        uint8_t *img = make_scene(SCENE_TEXTURE, w, h);
+        size_t len = 0;
+        CHECK_EQ(jpeg_encoder_encode(enc, img, w, h, out, sizeof(out), &len), ESP_OK);
+#if HAVE_LIBJPEG
+        double psnr = decode_psnr(out, len, img, w, h);
+        CHECK(psnr > 25.0);
+#endif
+        free(img);
+    }
+    jpeg_encoder_delete(enc);
+}
+
+static void test_errors(void)
+{
+    jpeg_encoder_handle_t enc;
+    uint8_t *img = make_scene(SCENE_NOISE, 64, 64);
+    uint8_t out[512];
+    size_t len = 0;
+
+    CHECK_EQ(jpeg_encoder_create(0, 10, 50, &enc), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(jpeg_encoder_create(10, 10, 0, &enc), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(jpeg_encoder_create(10, 10, 101, &enc), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(jpeg_encoder_create(64, 64, 50, &enc), ESP_OK);
+    CHECK_EQ(jpeg_encoder_set_quality(enc, 0), ESP_ERR_INVALID_ARG);
+    // Larger than the encoder was created for
+    CHECK_EQ(jpeg_encoder_encode(enc, img, 65, 64, out, 256, &len), ESP_ERR_INVALID_ARG);
+    // Noise never fits in 256 bytes; the encoder must stop at the buffer end
+    memset(out, 0xa5, sizeof(out));
+    CHECK_EQ(jpeg_encoder_encode(enc, img, 64, 64, out, 256, &len), ESP_ERR_INVALID_SIZE);
+    for (size_t i = 256; i < sizeof(out); i++)
+    {
+        CHECK_EQ(out[i], 0xa5);
+    }
+    jpeg_encoder_delete(enc);
+    free(img);
+}
+
+int main(void)
+{
+    RUN_TEST(test_scenes);
+    RUN_TEST(test_odd_sizes);
+    RUN_TEST(test_errors);
+    printf("All JPEG encoder tests passed\n");
+    return 0;
+}
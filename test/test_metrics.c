@@ -0,0 +1,206 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include "metrics.h"
+#include "test_util.h"
+
+// Histogram percentiles, exact counts under concurrent recording, 64-bit
+// totals read whole while they wrap 32 bits, the JSON snapshot, and the
+// reporting task's period, fixed rate and stop
+
+static void test_percentiles(void)
+{
+    metrics_summary_t s;
+
+    metrics_reset();
+    // Uniform 100 us .. 100 ms
+    for (int i = 1; i <= 1000; i++)
+    {
+        metrics_record(METRIC_FB_GET, i * 100);
+    }
+    metrics_get_summary(METRIC_FB_GET, &s);
+    printf("n=%u mean=%llu p50=%u p90=%u p99=%u max=%u\n", s.count, (unsigned long long)(s.total_us / s.count),
+           s.p50_us, s.p90_us, s.p99_us, s.max_us);
+    CHECK_EQ(s.count, 1000);
+    CHECK_EQ(s.total_us, 50050000);
+    CHECK_EQ(s.max_us, 100000);
+    // Interpolated within a power-of-two bucket, so within a few percent here
+    CHECK(s.p50_us > 47500 && s.p50_us < 52500);
+    CHECK(s.p90_us > 85500 && s.p90_us < 94500);
+    CHECK(s.p99_us > 94000 && s.p99_us <= 100000);
+
+    // Zero and negative durations land in the zero bucket
+    metrics_record(METRIC_DNS, 0);
+    metrics_record(METRIC_DNS, -5);
+    metrics_get_summary(METRIC_DNS, &s);
+    CHECK_EQ(s.count, 2);
+    CHECK_EQ(s.p50_us, 0);
+    CHECK_EQ(s.histogram[0], 2);
+}
+
+static void *record_worker(void *arg)
+{
+    for (int i = 0; i < 250000; i++)
+    {
+        metrics_record(METRIC_SEND, 5000 + i % 3);
+    }
+    return NULL;
+}
+
+// No sample is lost when several threads record into one stage at once
+static void test_concurrent(void)
+{
+    pthread_t threads[4];
+    metrics_summary_t s;
+
+    metrics_reset();
+    double start = test_now_s();
+    for (int i = 0; i < 4; i++)
+    {
+        pthread_create(&threads[i], NULL, record_worker, NULL);
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    double elapsed = test_now_s() - start;
+
+    metrics_get_summary(METRIC_SEND, &s);
+    printf("%u samples from 4 threads, %.1f M records/s\n", s.count, s.count / elapsed / 1e6);
+    CHECK_EQ(s.count, 1000000);
+    // 250000 per thread of 5000, 5001, 5002 in turn
+    CHECK_EQ(s.total_us, 4 * (250000ull * 5000 + 83333 * 1 + 83333 * 2));
+    CHECK_EQ(s.max_us, 5002);
+}
+
+static void *wrap_worker(void *arg)
+{
+    for (int i = 0; i < 100000; i++)
+    {
+        metrics_record(METRIC_RESPONSE, 3000000000u);
+    }
+    return NULL;
+}
+
+// The 64-bit total is read whole while writers carry it past 2^32 over and
+// over: it never goes backwards, which the rate controller's deltas rely on
+static void test_total_wrap(void)
+{
+    pthread_t threads[2];
+    metrics_summary_t s;
+    uint64_t prev = 0;
+    unsigned reads = 0, backwards = 0;
+
+    metrics_reset();
+    for (int i = 0; i < 2; i++)
+    {
+        pthread_create(&threads[i], NULL, wrap_worker, NULL);
+    }
+    do
+    {
+        metrics_get_summary(METRIC_RESPONSE, &s);
+        backwards += s.total_us < prev;
+        prev = s.total_us;
+        reads++;
+    } while (s.count < 200000);
+    for (int i = 0; i < 2; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    printf("%u reads while the total wrapped 32 bits, %u went backwards\n", reads, backwards);
+    CHECK_EQ(backwards, 0);
+    metrics_get_summary(METRIC_RESPONSE, &s);
+    CHECK_EQ(s.total_us, 200000ull * 3000000000u);
+}
+
+static void test_json(void)
+{
+    metrics_reset();
+    metrics_record(METRIC_CONNECT, 12000);
+    metrics_record_error(METRIC_RESPONSE);
+
+    cJSON *root = metrics_to_json();
+    CHECK(root);
+    cJSON *stages = cJSON_GetObjectItem(root, "stages");
+    CHECK(stages);
+    CHECK(cJSON_GetObjectItem(root, "uptime_ms"));
+    CHECK(cJSON_GetObjectItem(stages, "connect"));
+    CHECK(cJSON_GetObjectItem(cJSON_GetObjectItem(stages, "connect"), "p99_us"));
+    CHECK(cJSON_GetObjectItem(stages, "response"));
+    // Stages without samples or errors are left out
+    CHECK(!cJSON_GetObjectItem(stages, "fb_get"));
+
+    char *json = cJSON_PrintUnformatted(root);
+    CHECK(json);
+    printf("%s\n", json);
+    cJSON_free(json);
+    cJSON_Delete(root);
+}
+
+typedef struct {
+    atomic_int calls;
+    double first_s;
+    double last_s;
+    unsigned work_ms;       // Time the hook takes, like a busy snapshot
+} hook_state_t;
+
+static void count_hook(cJSON *snapshot, void *ctx)
+{
+    hook_state_t *h = ctx;
+
+    CHECK(cJSON_GetObjectItem(snapshot, "stages"));
+    cJSON_AddNumberToObject(snapshot, "hook", 1);
+    double now = test_now_s();
+    if (atomic_fetch_add(&h->calls, 1) == 0)
+    {
+        h->first_s = now;
+    }
+    h->last_s = now;
+    if (h->work_ms)
+    {
+        test_sleep_ms(h->work_ms);
+    }
+}
+
+// Snapshots come at the period even when each one takes a while to build, and
+// none come after stop returns
+static void test_reporting(void)
+{
+    const uint32_t period_ms = 50;
+    hook_state_t h = { .work_ms = 30 };
+
+    metrics_reset();
+    CHECK_EQ(metrics_start_reporting(0, count_hook, &h), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(metrics_start_reporting(period_ms, count_hook, &h), ESP_OK);
+    CHECK_EQ(metrics_start_reporting(period_ms, count_hook, &h), ESP_ERR_INVALID_STATE);
+    CHECK(WAIT_FOR(atomic_load(&h.calls) >= 11, 2000));
+    metrics_stop_reporting();
+    int calls = atomic_load(&h.calls);
+
+    double mean_ms = (h.last_s - h.first_s) * 1000 / (calls - 1);
+    printf("%d snapshots, %.1f ms apart with a %u ms hook\n", calls, mean_ms, h.work_ms);
+    // A delay after each snapshot would space them at least period + work
+    // apart. A fixed-rate schedule catches up after a late snapshot, so even a
+    // loaded host keeps the mean below that.
+    CHECK(mean_ms < period_ms + h.work_ms);
+
+    test_sleep_ms(3 * period_ms);
+    CHECK_EQ(atomic_load(&h.calls), calls);
+
+    // Reporting can be started again after a stop
+    hook_state_t h2 = {0};
+    CHECK_EQ(metrics_start_reporting(period_ms, count_hook, &h2), ESP_OK);
+    CHECK(WAIT_FOR(atomic_load(&h2.calls) >= 1, 1000));
+    metrics_stop_reporting();
+}
+
+int main(void)
+{
+    RUN_TEST(test_percentiles);
+    RUN_TEST(test_concurrent);
+    RUN_TEST(test_total_wrap);
+    RUN_TEST(test_json);
+    RUN_TEST(test_reporting);
+    printf("All metrics tests passed\n");
+    return 0;
+}
@@ -0,0 +1,234 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "q565.h"
+#include "test_util.h"
+
+// Lossless round trips of random images of random sizes, truncated, corrupt
+// and undersized buffers (which must fail cleanly, never read or write out of
+// bounds), and the compression ratio and MB/s on a camera-like scene
+
+static uint32_t s_rng = 12345;
+
+static uint32_t rnd(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+typedef enum {
+    CONTENT_NOISE,          // Mostly RAW ops
+    CONTENT_SPARSE_NOISE,   // One colour with specks: RUN and INDEX
+    CONTENT_GRADIENT,       // Smooth: DIFF and LUMA
+    CONTENT_DARK,           // Small values, residuals wrapping around zero
+    CONTENT_CHECKER,        // Alternating black and white: INDEX
+    CONTENT_COUNT,
+} content_t;
+
+static void fill(uint8_t *img, int w, int h, content_t content)
+{
+    for (int i = 0; i < w * h; i++)
+    {
+        int x = i % w, y = i / w;
+        uint16_t px;
+        switch (content)
+        {
+        case CONTENT_NOISE:
+            px = rnd();
+            break;
+        case CONTENT_SPARSE_NOISE:
+            px = rnd() % 4 ? 0x1234 : rnd();
+            break;
+        case CONTENT_GRADIENT:
+            px = (uint16_t)((x * 31 / w) << 11 | (y * 63 / h) << 5 | ((x + y) & 31));
+            break;
+        case CONTENT_DARK:
+            px = rnd() % 8;
+            break;
+        default:
+            px = (x + y) & 1 ? 0xffff : 0;
+            break;
+        }
+        img[2 * i] = px >> 8;
+        img[2 * i + 1] = px & 0xff;
+    }
+}
+
+// Encode and decode img, and check that every shorter stream and every too
+// small output buffer is rejected; returns the encoded size
+static size_t round_trip(const uint8_t *img, int w, int h)
+{
+    const size_t raw = (size_t)w * h * 2;
+    const size_t cap = Q565_MAX_SIZE(w, h);
+    uint8_t *enc = malloc(cap);
+    uint8_t *dec = malloc(raw);
+    size_t len, len2;
+    uint16_t ow, oh;
+
+    CHECK_EQ(q565_encode(img, w, h, enc, cap, &len), ESP_OK);
+    CHECK(len > Q565_HEADER_SIZE && len <= cap);
+    CHECK_EQ(q565_read_header(enc, len, &ow, &oh), ESP_OK);
+    CHECK(ow == w && oh == h);
+    CHECK_EQ(q565_decode(enc, len, dec, raw, &ow, &oh), ESP_OK);
+    CHECK(ow == w && oh == h);
+    CHECK(memcmp(dec, img, raw) == 0);
+
+    for (size_t cut = 0; cut < len; cut += len / 50 + 1)
+    {
+        CHECK(q565_decode(enc, cut, dec, raw, &ow, &oh) != ESP_OK);
+    }
+    CHECK_EQ(q565_decode(enc, len, dec, raw - 1, &ow, &oh), ESP_ERR_INVALID_SIZE);
+    CHECK_EQ(q565_encode(img, w, h, enc, len - 1, &len2), ESP_ERR_INVALID_SIZE);
+
+    free(enc);
+    free(dec);
+    return len;
+}
+
+static void test_fuzz_round_trip(void)
+{
+    size_t raw = 0, encoded = 0;
+
+    for (int i = 0; i < 3000; i++)
+    {
+        int w = 1 + rnd() % 70, h = 1 + rnd() % 40;
+        uint8_t *img = malloc((size_t)w * h * 2);
+
+        fill(img, w, h, i % CONTENT_COUNT);
+        encoded += round_trip(img, w, h);
+        raw += (size_t)w * h * 2;
+        free(img);
+    }
+    printf("3000 images, %zu bytes encoded to %zu\n", raw, encoded);
+}
+
+// Flipped bits anywhere after the header decode to something or fail, but
+// never touch memory outside the buffers (run under -fsanitize=address)
+static void test_corrupt_streams(void)
+{
+    int rejected = 0, decoded = 0;
+
+    for (int i = 0; i < 3000; i++)
+    {
+        int w = 1 + rnd() % 70, h = 1 + rnd() % 40;
+        size_t cap = Q565_MAX_SIZE(w, h), len;
+        uint8_t *img = malloc((size_t)w * h * 2);
+        uint8_t *enc = malloc(cap);
+        uint16_t ow, oh;
+
+        fill(img, w, h, i % CONTENT_COUNT);
+        CHECK_EQ(q565_encode(img, w, h, enc, cap, &len), ESP_OK);
+        for (int k = 0; k < 5; k++)
+        {
+            enc[Q565_HEADER_SIZE + rnd() % (len - Q565_HEADER_SIZE)] ^= 1 << (rnd() % 8);
+            if (q565_decode(enc, len, img, (size_t)w * h * 2, &ow, &oh) == ESP_OK)
+            {
+                decoded++;
+            }
+            else
+            {
+                rejected++;
+            }
+        }
+        free(enc);
+        free(img);
+    }
+    printf("Corrupt streams: %d rejected, %d decoded to some image\n", rejected, decoded);
+    CHECK(rejected > 0);
+}
+
+static void test_bad_header(void)
+{
+    uint8_t img[4 * 4 * 2] = {0};
+    uint8_t enc[Q565_MAX_SIZE(4, 4)];
+    uint8_t dec[sizeof(img)];
+    size_t len;
+    uint16_t w, h;
+
+    CHECK_EQ(q565_encode(img, 4, 4, enc, sizeof(enc), &len), ESP_OK);
+    CHECK_EQ(q565_read_header(enc, Q565_HEADER_SIZE - 1, &w, &h), ESP_ERR_INVALID_RESPONSE);
+
+    enc[0] ^= 1;  // Magic
+    CHECK_EQ(q565_decode(enc, len, dec, sizeof(dec), &w, &h), ESP_ERR_INVALID_RESPONSE);
+    enc[0] ^= 1;
+    enc[4] = enc[5] = 0;  // Zero width
+    CHECK_EQ(q565_read_header(enc, len, &w, &h), ESP_ERR_INVALID_RESPONSE);
+}
+
+// Flat regions collapse into runs; noise costs at most the RAW op per pixel
+static void test_bounds(void)
+{
+    const int w = 160, h = 120;
+    uint8_t *img = malloc(w * h * 2);
+
+    memset(img, 0x5a, w * h * 2);
+    size_t flat = round_trip(img, w, h);
+    printf("Flat QQVGA: %zu bytes\n", flat);
+    CHECK(flat < Q565_HEADER_SIZE + 4 + (size_t)w * h / 62);
+
+    fill(img, w, h, CONTENT_NOISE);
+    size_t noise = round_trip(img, w, h);
+    printf("Noise QQVGA: %zu bytes\n", noise);
+    CHECK(noise <= Q565_MAX_SIZE(w, h));
+    free(img);
+}
+
+// A gradient with an object and a little sensor noise in the low bits, like
+// the scenes the change detector tests use
+static void test_ratio_and_rate(void)
+{
+    const int w = 640, h = 480, runs = 50;
+    const size_t raw = (size_t)w * h * 2;
+    uint8_t *img = malloc(raw);
+    uint8_t *enc = malloc(Q565_MAX_SIZE(w, h));
+    uint8_t *dec = malloc(raw);
+    size_t len;
+    uint16_t ow, oh;
+
+    for (int y = 0; y < h; y++)
+    {
+        for (int x = 0; x < w; x++)
+        {
+            bool box = x >= 200 && x < 320 && y >= 150 && y < 260;
+            int r = box ? 28 : x * 31 / w;
+            int g = box ? 50 : y * 63 / h;
+            int b = (box ? 6 : 12) + (rnd() % 3 == 0);
+            uint16_t px = (uint16_t)(r << 11 | g << 5 | b);
+            img[(y * w + x) * 2] = px >> 8;
+            img[(y * w + x) * 2 + 1] = px & 0xff;
+        }
+    }
+    len = round_trip(img, w, h);
+
+    double start = test_now_s();
+    for (int i = 0; i < runs; i++)
+    {
+        CHECK_EQ(q565_encode(img, w, h, enc, Q565_MAX_SIZE(w, h), &len), ESP_OK);
+    }
+    double encoded = test_now_s();
+    for (int i = 0; i < runs; i++)
+    {
+        CHECK_EQ(q565_decode(enc, len, dec, raw, &ow, &oh), ESP_OK);
+    }
+    double decoded = test_now_s();
+    printf("VGA scene: %zu -> %zu bytes, ratio %.2f, encode %.0f MB/s, decode %.0f MB/s\n", raw, len,
+           (double)raw / len, runs * raw / (encoded - start) / 1e6, runs * raw / (decoded - encoded) / 1e6);
+    CHECK(raw / len >= 2);
+
+    free(img);
+    free(enc);
+    free(dec);
+}
+
+int main(void)
+{
+    RUN_TEST(test_fuzz_round_trip);
+    RUN_TEST(test_corrupt_streams);
+    RUN_TEST(test_bad_header);
+    RUN_TEST(test_bounds);
+    RUN_TEST(test_ratio_and_rate);
+    printf("All q565 tests passed\n");
+    return 0;
+}
@@ -0,0 +1,322 @@
+#include <stdbool.h>
+#include <string.h>
+#include "rate_controller.h"
+#include "test_util.h"
+
+// The rate controller driven by simulated bandwidth traces: a capture source
+// at the chosen level's interval and frame size, a drop-oldest queue and one
+// uploader on a link of the trace's bandwidth with a fixed round trip. The
+// controller is given each level's bytes per second, as the firmware learns
+// them. Each trace checks where the controller settles, how fast it reacts and how
+// often it changes level; the same trace always gives the same levels.
+
+#define TICK_MS     10
+#define PERIOD_MS   2000
+#define QUEUE_LEN   4
+#define RTT_MS      150
+#define TARGET_MS   3000
+#define TRACE_S     600
+
+// The firmware's ladder at QVGA: JPEG bytes per frame at each quality
+typedef struct {
+    uint32_t bytes;
+    uint32_t interval_ms;
+} level_t;
+
+static const level_t s_levels[] = {
+    { 6000, 8000 },     // q30
+    { 6000, 4000 },
+    { 9000, 4000 },     // q60
+    { 6000, 2000 },
+    { 9000, 2000 },
+    { 6000, 1000 },
+    { 8000, 1000 },     // q50
+    { 12500, 1000 },    // q80
+};
+
+#define NUM_LEVELS (sizeof(s_levels) / sizeof(s_levels[0]))
+#define TOP_LEVEL  (NUM_LEVELS - 1)
+
+typedef uint32_t (*trace_fn)(int t_s);   // Link bandwidth in bytes/s at second t_s
+
+typedef struct {
+    uint32_t frames;
+    uint32_t dropped;
+    uint32_t over_target;       // Frames with latency over the target
+    uint32_t changes;
+    uint64_t latency_sum_ms;
+    uint8_t levels[TRACE_S * 1000 / PERIOD_MS];   // Level after each period
+} sim_result_t;
+
+static void simulate(trace_fn bandwidth, sim_result_t *r)
+{
+    uint32_t level_bps[NUM_LEVELS];
+    for (size_t i = 0; i < NUM_LEVELS; i++)
+    {
+        level_bps[i] = s_levels[i].bytes * 1000 / s_levels[i].interval_ms;
+    }
+    rate_controller_config_t cfg = {
+        .num_levels = NUM_LEVELS,
+        .initial_level = TOP_LEVEL,
+        .target_latency_ms = TARGET_MS,
+        .max_queued = 1,
+        .up_busy_pct = 40,
+        .up_periods = 3,
+        .level_bps = level_bps,
+    };
+    rate_controller_handle_t c;
+    int queue_t[QUEUE_LEN];
+    uint32_t queue_bytes[QUEUE_LEN];
+    int queued = 0, next_capture = 0;
+    bool sending = false;
+    int send_capture = 0, rtt_left = 0;
+    double send_left = 0;
+    rate_sample_t s = { .period_ms = PERIOD_MS };
+    uint64_t period_latency = 0;
+
+    memset(r, 0, sizeof(*r));
+    CHECK_EQ(rate_controller_create(&cfg, &c), ESP_OK);
+    for (int t = 0; t < TRACE_S * 1000; t += TICK_MS)
+    {
+        const level_t *level = &s_levels[rate_controller_get_level(c)];
+        if (t >= next_capture)
+        {
+            if (queued == QUEUE_LEN)
+            {
+                memmove(queue_t, queue_t + 1, sizeof(int) * (QUEUE_LEN - 1));
+                memmove(queue_bytes, queue_bytes + 1, sizeof(uint32_t) * (QUEUE_LEN - 1));
+                queued--;
+                s.dropped++;
+                r->dropped++;
+            }
+            queue_t[queued] = t;
+            queue_bytes[queued++] = level->bytes;
+            next_capture = t + level->interval_ms;
+        }
+        if (!sending && queued)
+        {
+            sending = true;
+            send_capture = queue_t[0];
+            send_left = queue_bytes[0];
+            rtt_left = RTT_MS;
+            memmove(queue_t, queue_t + 1, sizeof(int) * (QUEUE_LEN - 1));
+            memmove(queue_bytes, queue_bytes + 1, sizeof(uint32_t) * (QUEUE_LEN - 1));
+            queued--;
+        }
+        if (sending)
+        {
+            s.busy_ms += TICK_MS;
+            if (send_left > 0)
+            {
+                double n = bandwidth(t / 1000) * (TICK_MS / 1000.0);
+                n = n < send_left ? n : send_left;
+                send_left -= n;
+                s.bytes += (uint64_t)n;
+            }
+            else if ((rtt_left -= TICK_MS) <= 0)
+            {
+                uint32_t latency = t + TICK_MS - send_capture;
+                sending = false;
+                s.frames++;
+                period_latency += latency;
+                r->frames++;
+                r->latency_sum_ms += latency;
+                r->over_target += latency > TARGET_MS;
+            }
+        }
+        if ((t + TICK_MS) % PERIOD_MS == 0)
+        {
+            s.queued = queued;
+            s.latency_ms = s.frames ? period_latency / s.frames : 0;
+            r->changes += rate_controller_update(c, &s);
+            r->levels[(t + TICK_MS) / PERIOD_MS - 1] = rate_controller_get_level(c);
+            memset(&s, 0, sizeof(s));
+            s.period_ms = PERIOD_MS;
+            period_latency = 0;
+        }
+    }
+    rate_controller_delete(c);
+}
+
+// Level at second t_s
+static size_t level_at(const sim_result_t *r, int t_s)
+{
+    return r->levels[t_s * 1000 / PERIOD_MS - 1];
+}
+
+static void report(const char *name, const sim_result_t *r)
+{
+    printf("%-12s frames %4u, dropped %3u, over target %3u (%.1f%%), mean latency %4llu ms, %u level changes\n",
+           name, r->frames, r->dropped, r->over_target, 100.0 * r->over_target / r->frames,
+           (unsigned long long)(r->latency_sum_ms / r->frames), r->changes);
+}
+
+static uint32_t trace_constant(int t_s)
+{
+    return 200000;
+}
+
+// A fast link that stays fast stays at the top level without dropping frames
+static void test_constant(void)
+{
+    sim_result_t r;
+
+    simulate(trace_constant, &r);
+    report("constant", &r);
+    CHECK_EQ(r.changes, 0);
+    CHECK_EQ(r.dropped, 0);
+    CHECK_EQ(r.over_target, 0);
+    CHECK_EQ(level_at(&r, TRACE_S), TOP_LEVEL);
+}
+
+static uint32_t trace_outage(int t_s)
+{
+    return t_s >= 120 && t_s < 240 ? 1500 : 200000;
+}
+
+// Bandwidth collapses for two minutes: the controller steps down to the
+// bottom within a few periods and climbs back to the top once it returns
+static void test_outage(void)
+{
+    sim_result_t r;
+
+    simulate(trace_outage, &r);
+    report("outage", &r);
+    CHECK_EQ(level_at(&r, 118), TOP_LEVEL);
+    CHECK(level_at(&r, 130) <= 1);
+    CHECK(level_at(&r, 238) <= 1);
+    int back = 0;
+    for (int t = 240; t <= TRACE_S && !back; t += PERIOD_MS / 1000)
+    {
+        back = level_at(&r, t) == TOP_LEVEL ? t : 0;
+    }
+    printf("back at the top %d s after the outage\n", back - 240);
+    CHECK(back > 240 && back - 240 <= 120);
+}
+
+static uint32_t trace_square(int t_s)
+{
+    return (t_s / 30) % 2 ? 4000 : 20000;
+}
+
+// A link that alternates between two rates every 30 s is not probed beyond
+// what it carries over and over: failed probes back off
+static void test_square_wave(void)
+{
+    sim_result_t r;
+
+    simulate(trace_square, &r);
+    report("square wave", &r);
+    CHECK(r.changes < TRACE_S / 10);
+    CHECK(r.over_target * 10 < r.frames);
+    // Late in a slow half: a level the 4 kB/s link can carry
+    CHECK(s_levels[level_at(&r, 58)].bytes * 1000 / s_levels[level_at(&r, 58)].interval_ms <= 4000);
+}
+
+static uint32_t trace_jitter(int t_s)
+{
+    return 6000 + (t_s * 7919 % 11) * 1500;
+}
+
+// A noisy link settles on a level it can carry instead of oscillating
+static void test_jitter(void)
+{
+    sim_result_t r;
+
+    simulate(trace_jitter, &r);
+    report("jitter", &r);
+    CHECK(r.changes < TRACE_S / 20);
+    CHECK(r.over_target * 20 < r.frames);
+    CHECK(level_at(&r, TRACE_S) > 0 && level_at(&r, TRACE_S) < TOP_LEVEL);
+}
+
+static uint32_t trace_drop(int t_s)
+{
+    return t_s < 60 ? 200000 : 5000;
+}
+
+static uint32_t level_rate(size_t level)
+{
+    return s_levels[level].bytes * 1000 / s_levels[level].interval_ms;
+}
+
+// The link drops to 5 kB/s for good: the first decision after the drop goes
+// straight to a level the measured throughput carries instead of stepping
+// down two at a time, and no later probe asks for more than the link has
+static void test_throughput(void)
+{
+    sim_result_t r;
+
+    simulate(trace_drop, &r);
+    report("drop", &r);
+    printf("level %zu after the drop, %zu at the end\n", level_at(&r, 62), level_at(&r, TRACE_S));
+    CHECK_EQ(level_at(&r, 60), TOP_LEVEL);
+    CHECK(level_at(&r, 62) > 0 && level_rate(level_at(&r, 62)) <= 5000);
+    for (int t = 62; t <= TRACE_S; t += PERIOD_MS / 1000)
+    {
+        CHECK(level_rate(level_at(&r, t)) <= 5000);
+    }
+    CHECK(level_at(&r, TRACE_S) > 0);
+    CHECK(r.changes < 10);
+}
+
+// Integer-only decisions: a trace replays to the same levels
+static void test_deterministic(void)
+{
+    static sim_result_t a, b;
+
+    simulate(trace_jitter, &a);
+    simulate(trace_jitter, &b);
+    CHECK(memcmp(a.levels, b.levels, sizeof(a.levels)) == 0);
+    simulate(trace_square, &a);
+    simulate(trace_square, &b);
+    CHECK(memcmp(a.levels, b.levels, sizeof(a.levels)) == 0);
+}
+
+static void test_config_and_idle(void)
+{
+    rate_controller_config_t cfg = {
+        .num_levels = 4,
+        .initial_level = 4,
+        .target_latency_ms = TARGET_MS,
+        .up_periods = 1,
+    };
+    rate_controller_handle_t c;
+
+    CHECK_EQ(rate_controller_create(&cfg, &c), ESP_ERR_INVALID_ARG);
+    cfg.initial_level = 3;
+    cfg.up_periods = 0;
+    CHECK_EQ(rate_controller_create(&cfg, &c), ESP_ERR_INVALID_ARG);
+    cfg.up_periods = 1;
+    CHECK_EQ(rate_controller_create(&cfg, &c), ESP_OK);
+
+    // Nothing uploaded, nothing learned
+    rate_sample_t idle = { .period_ms = PERIOD_MS };
+    for (int i = 0; i < 10; i++)
+    {
+        CHECK(!rate_controller_update(c, &idle));
+    }
+    CHECK_EQ(rate_controller_get_level(c), 3);
+    CHECK_EQ(rate_controller_get_throughput(c), 0);
+
+    // Dropped frames step down two levels at once
+    rate_sample_t congested = { .period_ms = PERIOD_MS, .frames = 1, .dropped = 2, .queued = 4,
+                                .busy_ms = PERIOD_MS, .bytes = 10000, .latency_ms = 5000 };
+    CHECK(rate_controller_update(c, &congested));
+    CHECK_EQ(rate_controller_get_level(c), 1);
+    CHECK_EQ(rate_controller_get_throughput(c), 5000);
+    rate_controller_delete(c);
+}
+
+int main(void)
+{
+    RUN_TEST(test_constant);
+    RUN_TEST(test_outage);
+    RUN_TEST(test_square_wave);
+    RUN_TEST(test_jitter);
+    RUN_TEST(test_throughput);
+    RUN_TEST(test_deterministic);
+    RUN_TEST(test_config_and_idle);
+    printf("All rate controller tests passed\n");
+    return 0;
+}
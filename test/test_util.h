@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+// Minimal assertion and timing helpers shared by the host tests. A failed
+// CHECK reports the location and exits, which ctest counts as a failure.
+
+#define CHECK(cond)                                                             \
+    do                                                                          \
+    {                                                                           \
+        if (!(cond))                                                            \
+        {                                                                       \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1);                                                            \
+        }                                                                       \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                          \
+    do                                                                          \
+    {                                                                           \
+        long long a_ = (long long)(a), b_ = (long long)(b);                     \
+        if (a_ != b_)                                                           \
+        {                                                                       \
+            fprintf(stderr, "%s:%d: CHECK failed: %s == %s (%lld vs %lld)\n",   \
+                    __FILE__, __LINE__, #a, #b, a_, b_);                        \
+            exit(1);                                                            \
+        }                                                                       \
+    } while (0)
+
+#define RUN_TEST(fn)                     \
+    do                                   \
+    {                                    \
+        printf("-- %s\n", #fn);          \
+        fflush(stdout);                  \
+        fn();                            \
+    } while (0)
+
+static inline double test_now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static inline void test_sleep_ms(unsigned ms)
+{
+    usleep(ms * 1000u);
+}
+
+// Poll cond for up to timeout_ms; evaluates to whether it came true
+#define WAIT_FOR(cond, timeout_ms)                                  \
+    ({                                                              \
+        double until_ = test_now_s() + (timeout_ms) / 1000.0;       \
+        while (!(cond) && test_now_s() < until_)                    \
+        {                                                           \
+            test_sleep_ms(1);                                       \
+        }                                                           \
+        (cond);                                                     \
+    })
@@ -0,0 +1,216 @@
+#!/usr/bin/env python3
+"""Read and validate frame packs written by main/frame_pack.c.
+
+A pack is read the way a client would read it from S3: the 32-byte trailer
+at the end, then the index it points to, then individual frames by offset.
+The source can be a local file or an http(s) URL; URLs are read with ranged
+GETs, so extracting one frame never downloads the whole object.
+
+    frame_pack.py info     PACK
+    frame_pack.py validate PACK
+    frame_pack.py extract  PACK OUTDIR [--frame N]
+"""
+
+import argparse
+import datetime
+import os
+import struct
+import sys
+import urllib.request
+import zlib
+
+HEADER = struct.Struct("<IHHq12sI")         # magic, version, header_size, created_us, reserved, crc
+RECORD = struct.Struct("<IIqIHHB3sI")       # magic, length, timestamp_us, crc32, w, h, format, reserved, crc
+INDEX_ENTRY = struct.Struct("<QIIqHHB3s")   # offset, length, crc32, timestamp_us, w, h, format, reserved
+TRAILER = struct.Struct("<IHHIIQII")        # magic, version, entry_size, frames, index_crc, index_offset, reserved, crc
+
+HEADER_MAGIC = 0x4B415046   # "FPAK"
+RECORD_MAGIC = 0x30524D46   # "FMR0"
+TRAILER_MAGIC = 0x584B5046  # "FPKX"
+VERSION = 1
+
+FORMATS = {0: ("rgb565", "raw"), 1: ("jpeg", "jpg"), 2: ("q565", "q565")}
+
+
+class PackError(Exception):
+    pass
+
+
+class FileSource:
+    def __init__(self, path):
+        self.f = open(path, "rb")
+        self.f.seek(0, os.SEEK_END)
+        self.size = self.f.tell()
+
+    def read(self, offset, length):
+        self.f.seek(offset)
+        data = self.f.read(length)
+        if len(data) != length:
+            raise PackError(f"short read at {offset}")
+        return data
+
+    def tail(self, length):
+        if self.size < length:
+            raise PackError("file too short")
+        return self.read(self.size - length, length)
+
+
+class HttpSource:
+    def __init__(self, url):
+        self.url = url
+        self.size = None
+        self.requests = 0
+
+    def _get(self, range_value):
+        req = urllib.request.Request(self.url, headers={"Range": "bytes=" + range_value})
+        self.requests += 1
+        with urllib.request.urlopen(req) as resp:
+            if resp.status != 206:
+                raise PackError(f"server ignored the range request (HTTP {resp.status})")
+            total = resp.headers.get("Content-Range", "").rpartition("/")[2]
+            if total.isdigit():
+                self.size = int(total)
+            return resp.read()
+
+    def read(self, offset, length):
+        if length == 0:
+            return b""
+        data = self._get(f"{offset}-{offset + length - 1}")
+        if len(data) != length:
+            raise PackError(f"short read at {offset}")
+        return data
+
+    def tail(self, length):
+        data = self._get(f"-{length}")
+        if len(data) != length:
+            raise PackError("object too short")
+        return data
+
+
+def crc32(data):
+    return zlib.crc32(data) & 0xFFFFFFFF
+
+
+def open_source(location):
+    if location.startswith(("http://", "https://")):
+        return HttpSource(location)
+    return FileSource(location)
+
+
+def read_header(src):
+    """Return the creation time from the file header."""
+    raw = src.read(0, HEADER.size)
+    magic, version, header_size, created_us, _, header_crc = HEADER.unpack(raw)
+    if magic != HEADER_MAGIC or crc32(raw[:-4]) != header_crc or header_size != HEADER.size:
+        raise PackError("bad file header")
+    return created_us
+
+
+def read_index(src):
+    """Return (index_offset, entries) from the trailer and index: two reads."""
+    raw = src.tail(TRAILER.size)
+    magic, version, entry_size, frames, index_crc, index_offset, _, trailer_crc = TRAILER.unpack(raw)
+    if magic != TRAILER_MAGIC:
+        raise PackError("no trailer; the pack was not finished")
+    if crc32(raw[:-4]) != trailer_crc:
+        raise PackError("trailer CRC mismatch")
+    if version != VERSION or entry_size != INDEX_ENTRY.size:
+        raise PackError(f"unsupported version {version}")
+    if src.size is not None and index_offset + frames * entry_size + TRAILER.size != src.size:
+        raise PackError("index does not end at the trailer")
+
+    index = src.read(index_offset, frames * entry_size)
+    if crc32(index) != index_crc:
+        raise PackError("index CRC mismatch")
+
+    entries = []
+    for i in range(frames):
+        offset, length, crc, ts, w, h, fmt, _ = INDEX_ENTRY.unpack_from(index, i * entry_size)
+        if offset < HEADER.size + RECORD.size or offset + length > index_offset:
+            raise PackError(f"frame {i} lies outside the record area")
+        entries.append(dict(offset=offset, length=length, crc32=crc, timestamp_us=ts,
+                            width=w, height=h, format=fmt))
+    return index_offset, entries
+
+
+def read_frame(src, entry):
+    data = src.read(entry["offset"], entry["length"])
+    if crc32(data) != entry["crc32"]:
+        raise PackError(f"payload CRC mismatch at offset {entry['offset']}")
+    return data
+
+
+def format_time(us):
+    return datetime.datetime.fromtimestamp(us / 1e6, datetime.timezone.utc).isoformat(timespec="milliseconds")
+
+
+def cmd_info(src, args):
+    index_offset, entries = read_index(src)
+    created_us = read_header(src)
+    print(f"created {format_time(created_us)}, {len(entries)} frames, "
+          f"{index_offset} bytes of records, {src.size} bytes total")
+    for i, e in enumerate(entries):
+        name = FORMATS.get(e["format"], (f"format {e['format']}",))[0]
+        print(f"{i:4d}  {format_time(e['timestamp_us'])}  {e['width']}x{e['height']}  {name:7s}"
+              f"  {e['length']:8d} bytes @ {e['offset']}")
+    return 0
+
+
+def cmd_validate(src, args):
+    """Check the index against the records as well as every payload CRC."""
+    index_offset, entries = read_index(src)
+    read_header(src)
+    pos = HEADER.size
+    for i, e in enumerate(entries):
+        raw = src.read(pos, RECORD.size)
+        magic, length, ts, crc, w, h, fmt, _, header_crc = RECORD.unpack(raw)
+        if magic != RECORD_MAGIC or crc32(raw[:-4]) != header_crc:
+            raise PackError(f"frame {i}: bad record header at {pos}")
+        if (pos + RECORD.size, length, crc, ts, w, h, fmt) != (
+                e["offset"], e["length"], e["crc32"], e["timestamp_us"], e["width"], e["height"], e["format"]):
+            raise PackError(f"frame {i}: index does not match the record")
+        read_frame(src, e)
+        pos += RECORD.size + length
+    if pos != index_offset:
+        raise PackError(f"{index_offset - pos} unindexed bytes before the index")
+    print(f"OK: {len(entries)} frames")
+    return 0
+
+
+def cmd_extract(src, args):
+    _, entries = read_index(src)
+    selected = range(len(entries)) if args.frame is None else [args.frame]
+    os.makedirs(args.outdir, exist_ok=True)
+    for i in selected:
+        if not 0 <= i < len(entries):
+            raise PackError(f"no frame {i}")
+        e = entries[i]
+        ext = FORMATS.get(e["format"], (None, "bin"))[1]
+        path = os.path.join(args.outdir, f"frame_{i:04d}_{e['width']}x{e['height']}.{ext}")
+        with open(path, "wb") as f:
+            f.write(read_frame(src, e))
+        print(path)
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="command", required=True)
+    for name in ("info", "validate", "extract"):
+        p = sub.add_parser(name)
+        p.add_argument("pack", help="pack file or http(s) URL")
+        if name == "extract":
+            p.add_argument("outdir")
+            p.add_argument("--frame", type=int, help="extract only this frame")
+    args = parser.parse_args()
+
+    commands = {"info": cmd_info, "validate": cmd_validate, "extract": cmd_extract}
+    try:
+        return commands[args.command](open_source(args.pack), args)
+    except (PackError, OSError) as e:
+        print(f"{args.pack}: {e}", file=sys.stderr)
+        return 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
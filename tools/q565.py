@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+"""Decode lossless q565 frames written by main/q565.c.
+
+The output is the exact RGB565 image the camera produced, either as raw
+big-endian RGB565 (the device's .raw uploads) or as a PPM for viewing.
+
+    q565.py decode FRAME.q565 OUT.raw
+    q565.py decode FRAME.q565 OUT.ppm
+    q565.py info   FRAME.q565
+"""
+
+import argparse
+import struct
+import sys
+
+MAGIC = b"q565"
+HEADER = struct.Struct("<4sHH")   # magic, width, height
+
+OP_DIFF = 0x40
+OP_LUMA = 0x80
+OP_RUN = 0xC0
+OP_RAW = 0xFF
+
+
+class Q565Error(Exception):
+    pass
+
+
+def read_header(data):
+    if len(data) < HEADER.size:
+        raise Q565Error("too short")
+    magic, width, height = HEADER.unpack_from(data)
+    if magic != MAGIC or width == 0 or height == 0:
+        raise Q565Error("not a q565 stream")
+    return width, height
+
+
+def hash_pixel(px):
+    return ((px * 0x9E3779B1) & 0xFFFFFFFF) >> 26
+
+
+def med(a, b, c):
+    hi, lo = max(a, b), min(a, b)
+    if c >= hi:
+        return lo
+    if c <= lo:
+        return hi
+    return a + b - c
+
+
+def predict(pixels, i, x, width, prev):
+    if i < width:
+        return prev
+    b = pixels[i - width]
+    if x == 0:
+        return b
+    a, c = prev, pixels[i - width - 1]
+    return (med(a >> 11, b >> 11, c >> 11) << 11 |
+            med(a >> 5 & 63, b >> 5 & 63, c >> 5 & 63) << 5 |
+            med(a & 31, b & 31, c & 31))
+
+
+def div2(v):
+    """C integer division by two, which truncates toward zero."""
+    return -(-v // 2) if v < 0 else v // 2
+
+
+def decode(data):
+    """Return (width, height, pixels) with pixels as a list of RGB565 values."""
+    width, height = read_header(data)
+    count = width * height
+    pixels = [0] * count
+    index = [0] * 64
+    prev = 0
+    pos = HEADER.size
+    i = 0
+    while i < count:
+        if pos >= len(data):
+            raise Q565Error(f"stream ends after {i} of {count} pixels")
+        op = data[pos]
+        pos += 1
+        if op == OP_RAW:
+            if pos + 2 > len(data):
+                raise Q565Error("truncated raw pixel")
+            px = data[pos] << 8 | data[pos + 1]
+            pos += 2
+        elif op & 0xC0 == OP_RUN:
+            run = (op & 0x3F) + 1
+            if i + run > count:
+                raise Q565Error("run past the end of the image")
+            pixels[i:i + run] = [prev] * run
+            i += run
+            continue
+        elif op & 0xC0 == 0:
+            prev = pixels[i] = index[op]
+            i += 1
+            continue
+        else:
+            if op & 0xC0 == OP_DIFF:
+                dr, dg, db = (op >> 4 & 3) - 2, (op >> 2 & 3) - 2, (op & 3) - 2
+            else:
+                if pos >= len(data):
+                    raise Q565Error("truncated luma op")
+                rb = data[pos]
+                pos += 1
+                dg = (op & 0x3F) - 32
+                dr = (rb >> 4) - 8 + div2(dg)
+                db = (rb & 15) - 8 + div2(dg)
+            pred = predict(pixels, i, i % width, width, prev)
+            px = (((pred >> 11) + dr) & 31) << 11 | (((pred >> 5 & 63) + dg) & 63) << 5 | ((pred & 31) + db) & 31
+        index[hash_pixel(px)] = px
+        prev = pixels[i] = px
+        i += 1
+    if pos != len(data):
+        raise Q565Error(f"{len(data) - pos} bytes after the last pixel")
+    return width, height, pixels
+
+
+def to_raw(pixels):
+    return b"".join(struct.pack(">H", px) for px in pixels)
+
+
+def to_ppm(width, height, pixels):
+    out = bytearray(f"P6 {width} {height} 255\n".encode())
+    for px in pixels:
+        r, g, b = px >> 11, px >> 5 & 63, px & 31
+        out += bytes((r << 3 | r >> 2, g << 2 | g >> 4, b << 3 | b >> 2))
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="command", required=True)
+    p = sub.add_parser("info")
+    p.add_argument("input")
+    p = sub.add_parser("decode")
+    p.add_argument("input")
+    p.add_argument("output", help=".ppm for an image, anything else for raw big-endian RGB565")
+    args = parser.parse_args()
+
+    try:
+        with open(args.input, "rb") as f:
+            data = f.read()
+        if args.command == "info":
+            width, height = read_header(data)
+            print(f"{width}x{height}, {len(data)} bytes, ratio {width * height * 2 / len(data):.2f}")
+            return 0
+        width, height, pixels = decode(data)
+        out = to_ppm(width, height, pixels) if args.output.endswith(".ppm") else to_raw(pixels)
+        with open(args.output, "wb") as f:
+            f.write(out)
+    except (Q565Error, OSError) as e:
+        print(f"{args.input}: {e}", file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())